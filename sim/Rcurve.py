@@ -5,51 +5,57 @@ import seaborn as sns
 import os
 import time
 
+from resultstore import ResultStore
+
 # === CONFIGURACIÓN ===
-EXECUTABLE = './exp1.exe'  # Asegúrate de que este es el nombre de tu exe
+LAUNCHER = './jobs.exe'            # Lanzador de trabajos (jobs.cpp + model.cpp)
+QUEUE_DIR = 'queue_Rcurve'         # Cola de trabajos: permite relanzar tras un fallo sin repetir lo hecho
+GRID_FILE = 'grid_Rcurve.txt'
+TABLE_FILE = 'table_Rcurve.txt'    # Tabla con todos los resultados agregados
+STORE_DIR = os.path.join(QUEUE_DIR, 'store')   # Almacén columnar que rellenan los trabajos
+SITE = 'Dolebury_Warren'
 STEP_H = "0.01"                    # El paso de integración que usas siempre
-METRIC_FILE = "robustnessD.txt" # El archivo donde guardaste la R final
+NUM_WORKERS = os.cpu_count()
+DEFAULT_PARAMS = {'m': 0.2, 'r': 2.0, 'Kp': 100, 'Kv': 1000, 'ha': 1.0, 'd': 0.3, 'alpha': 1.0}   # Params de model.h
 
 # Valores de D a probar (Escala logarítmica suele ser mejor para barridos amplios)
 # Probamos desde aislamiento (0) hasta conectividad extrema (100)
 D_values = [0.0, 0.01, 0.05, 0.1, 0.25, 0.5, 1.0, 1.5, 2.5, 5.0, 10.0, 20.0, 50.0, 100.0]
 
+print(f"Iniciando barrido de D para {len(D_values)} valores con {NUM_WORKERS} procesos...")
+
+# 1. Una línea por trabajo: site h D strategy seed
+with open(GRID_FILE, 'w') as f:
+    for D in D_values:
+        f.write(f"{SITE} {STEP_H} {D} ordered 0\n")
+
+# 2. Encolar, ejecutar en paralelo y juntar (los trabajos ya terminados se saltan)
+subprocess.run([LAUNCHER, 'init', QUEUE_DIR, GRID_FILE], check=True)
+run = subprocess.run([LAUNCHER, 'run', QUEUE_DIR, str(NUM_WORKERS)])
+if run.returncode != 0:
+    print("Algunos trabajos no terminaron: vuelve a ejecutar el script para completarlos.")
+subprocess.run([LAUNCHER, 'merge', QUEUE_DIR, TABLE_FILE], check=True)
+
+# 3. Leer el almacén: R es la media de la robustez a lo largo de cada curva de extinción
+store = ResultStore(STORE_DIR)
+
 results_R = []
 
-print(f"Iniciando barrido de D para {len(D_values)} valores...")
 print("-" * 40)
 print(f"{'D':<10} | {'R (Robustez)':<15}")
 print("-" * 40)
 
 for D in D_values:
-    # 1. Preparar la entrada para el programa C++
-    # El programa espera: h (enter) D (enter)
-    input_str = f"{STEP_H}\n{D}\n"
-    
-    # 2. Ejecutar C++ y pasarle los datos
-    try:
-        # subprocess.run lanza el programa, le pasa el input y espera que acabe
-        process = subprocess.run(
-            [EXECUTABLE], 
-            input=input_str, 
-            text=True, 
-            capture_output=True, # Capturamos lo que imprime por pantalla para que no ensucie
-            check=True
-        )
-        
-        # 3. Leer el resultado
-        if os.path.exists(METRIC_FILE):
-            with open(METRIC_FILE, 'r') as f:
-                r_val = float(f.read().strip())
-                results_R.append(r_val)
-                print(f"{D:<10} | {r_val:.5f}")
-        else:
-            print(f"Error: No se generó {METRIC_FILE} para D={D}")
-            results_R.append(0)
-            
-    except subprocess.CalledProcessError as e:
-        print(f"Error ejecutando C++ para D={D}: {e}")
-        results_R.append(0)
+    # Solo las curvas de este barrido: doble precisión, mismo paso y parámetros por defecto
+    _, curves_R = store.robustness(site=SITE, D=D, strategy='ordered', precision='double', h=float(STEP_H),
+                                   params=DEFAULT_PARAMS)
+    if len(curves_R):
+        r_val = float(np.mean(curves_R))
+        print(f"{D:<10} | {r_val:.5f}")
+    else:
+        print(f"Error: No hay resultados para D={D}")
+        r_val = 0
+    results_R.append(r_val)
 
 # === GRAFICAR ===
 sns.set_theme(style="whitegrid")
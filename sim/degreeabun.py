@@ -3,120 +3,44 @@ import matplotlib.pyplot as plt
 import seaborn as sns
 import numpy as np
 
+from metapop import Model
+
 # === CONFIGURACIÓN ===
 INTERACTION_FILE = 'interactions_Dolebury_Warren_patches.txt' 
-EVO_P_FILE = 'evolutionp.txt'
-EVO_V_FILE = 'evolutionv.txt'
+STEP_H = 0.01
+D = 1.0
 
 sns.set_theme(style="whitegrid")
 
-def parse_interactions_and_get_degrees(filename):
+def get_degrees(model):
     """
-    Replica la lógica de carga de C++ para asegurar que los IDs coinciden
-    y calcula el Grado (número de parejas únicas) de cada especie.
+    Grado (número de parejas únicas) de cada especie, con los mismos IDs
+    que usa el motor C++.
     """
-    plant_index = {}
-    insect_index = {}
-    plant_count = 0
-    insect_count = 0
+    # Una interacción existe si tiene peso positivo en algún parche
+    links = (model.gamma() > 0).any(axis=0)   # plantas x insectos
     
-    # Estructuras para guardar conexiones (Sets para contar únicos)
-    plant_connections = {} # ID -> Set of insect IDs
-    insect_connections = {} # ID -> Set of plant IDs
-
-    print(f"Leyendo red desde {filename}...")
-    try:
-        with open(filename, 'r') as f:
-            for line in f:
-                parts = line.split()
-                if len(parts) < 4: continue
-                
-                # Formato: site patch plant insect weight (o similar según tu parser C++)
-                # Tu parser C++: site >> plant >> insect >> weight
-                # Python split() separa por espacios
-                # Asumimos que el archivo tiene 4 columnas: site_id plant_name insect_name weight
-                
-                # Ajusta esto si tu archivo tiene otro formato
-                # En tu C++ loadGamma: site >> plant >> insect >> weight
-                try:
-                    site = parts[0]
-                    plant = parts[1]
-                    insect = parts[2]
-                    weight = float(parts[3])
-                except ValueError:
-                    continue 
-
-                # Asignar IDs (Lógica idéntica a C++)
-                if plant not in plant_index:
-                    plant_index[plant] = plant_count
-                    plant_connections[plant_count] = set()
-                    plant_count += 1
-                
-                if insect not in insect_index:
-                    insect_index[insect] = insect_count
-                    insect_connections[insect_count] = set()
-                    insect_count += 1
-                
-                p_id = plant_index[plant]
-                v_id = insect_index[insect]
-                
-                # Guardar conexión si el peso es positivo
-                if weight > 0:
-                    plant_connections[p_id].add(v_id)
-                    insect_connections[v_id].add(p_id)
-                    
-    except FileNotFoundError:
-        print(f"Error: No encuentro {filename}")
-        return None, None
-
-    # Calcular grados
-    k_plants = [len(plant_connections[i]) for i in range(plant_count)]
-    k_insects = [len(insect_connections[i]) for i in range(insect_count)]
+    k_plants = links.sum(axis=1)
+    k_insects = links.sum(axis=0)
     
     return k_plants, k_insects
 
-def get_abundances(filename, num_species):
-    """Lee la última línea del archivo de evolución para obtener el estado estacionario"""
-    try:
-        # Leemos solo la última línea para ahorrar memoria
-        with open(filename, 'r') as f:
-            lines = f.readlines()
-            if not lines: return None
-            last_line = lines[-1].strip().split()
-            
-            # La primera columna es el tiempo, el resto son poblaciones
-            # Formato: t p0_s0 p0_s1 ... p1_s0 ...
-            # Necesitamos sumar la población de cada especie en todos sus parches
-            
-            data = np.array([float(x) for x in last_line[1:]])
-            
-            # El array data tiene longitud: num_species * num_patches
-            # Deducimos num_patches
-            if len(data) % num_species != 0:
-                print(f"Error dimensiones: Datos {len(data)} no divisible por especies {num_species}")
-                return None
-            
-            num_patches = int(len(data) / num_species)
-            
-            # Reshape a (num_species, num_patches) y sumar parches
-            abundances_matrix = data.reshape((num_species, num_patches))
-            total_abundances = np.sum(abundances_matrix, axis=1)
-            
-            return total_abundances
-            
-    except FileNotFoundError:
-        print(f"Error: No encuentro {filename}")
-        return None
+def get_abundances(model):
+    """Abundancias del estado estacionario, sumando la población de cada especie en todos sus parches"""
+    p, v = model.steady_state(STEP_H, D)
+    return p.sum(axis=1), v.sum(axis=1)
 
 # === EJECUCIÓN ===
 
+print(f"Leyendo red desde {INTERACTION_FILE}...")
+model = Model(INTERACTION_FILE)
+
 # 1. Obtener Estructura (Grados)
-k_p, k_v = parse_interactions_and_get_degrees(INTERACTION_FILE)
+k_p, k_v = get_degrees(model)
 
 if k_p is not None:
     # 2. Obtener Dinámica (Abundancias)
-    n_p = get_abundances(EVO_P_FILE, len(k_p))
-    n_v = get_abundances(EVO_V_FILE, len(k_v))
+    n_p, n_v = get_abundances(model)
 
     if n_p is not None and n_v is not None:
         
@@ -1,12 +1,19 @@
 //First experiment
 
-#include "model.h"
+#include "sensitivity.h"
+#include "resultstore.h"
 
-int main(void)
+int main(int argc, char** argv)
 {
     double h, t, D;
     ofstream fichp, fichv;
     
+    //Parameters: ./exp1.exe [params.txt] [key=value ...] [threads=N]
+    Params par;
+    if (!readParams(argc, argv, par))
+        return 1;
+    printParams(par);
+    
     cout << "Introduce the step: " << endl;
     cin >> h;
 
@@ -29,38 +36,9 @@ int main(void)
     
     //Initialization
     
-    vector <vector<double>> p(plantCount,vector<double>(numPatch));
-    vector <vector<double>> v(insectCount,vector<double>(numPatch));
-    
-    for(int i=0 ; i<plantCount ; i++)
-    {
-        for(int site=0 ; site<numPatch ; site++)
-        {
-            if (plantExistsInPatch(i, site, insectCount, gamma)) 
-            {
-                p[i][site] = 100.0;
-            } 
-            else 
-            {
-                p[i][site] = 0.0; 
-            } 
-        }
-    }
-    
-    for(int i=0 ; i<insectCount ; i++)
-    {
-        for(int site=0 ; site<numPatch ; site++)
-        {
-            if (insectExistsInPatch(i, site, plantCount, gamma)) 
-            {
-                v[i][site] = 500.0;
-            } 
-            else 
-            {
-                v[i][site] = 0.0;
-            }
-        }
-    }   
+    vector <vector<double>> p, v;
+    
+    initializeState(p, v, gamma, plantCount, insectCount, numPatch);
     
     //Run
     fichp.open("evolutionp.txt");
@@ -68,9 +46,22 @@ int main(void)
 
     t = 0.0;
     
-    findSteadyState(t, p, v, fichp, fichv, plantCount, insectCount, numPatch, gamma, h, D);
+    findSteadyState(t, p, v, fichp, fichv, plantCount, insectCount, numPatch, gamma, par, h, D);
+    
+    //Sensitivities of the steady state to D and the model parameters
+    vector<vector<double>> sens;
+    if (steadyStateSensitivities(p, v, gamma, par, plantCount, insectCount, numPatch, D, sens))
+        writeSensitivities(p, v, sens, speciesNames(plantIndex, insectIndex, plantCount, insectCount), par, plantCount, insectCount, numPatch, D, "sensitivities.txt");
+    else
+        cout << "Singular Jacobian: no sensitivities for this steady state." << endl;
+    
+    vector<ExtinctionStep> curve = runExtinctionExperiment(p,v,gamma,par,h,plantCount,insectCount,numPatch, D);
+    
+    //Runs with different inputs share the store; repeating a run replaces its earlier curve
+    uint64_t tag = runTag("Dolebury_Warren", h, D, STRATEGY_ORDERED, 0, par, PRECISION_DOUBLE);
+    appendToStore("results.store", "Dolebury_Warren", h, D, STRATEGY_ORDERED, 0, par, PRECISION_DOUBLE, curve, tag, true);
     
-    runExtinctionExperiment(p,v,gamma,h,plantCount,insectCount,numPatch, D);
+    writeExtinctionResults(curve, "results.txt", "robustnessD.txt");
     
     fichp.close();
     fichv.close();
@@ -0,0 +1,97 @@
+//Habitat-loss experiment: patches removed by increasing abundance and in random orders, from the steady state
+//
+//  ./expHabitat.exe <site> <h> <D> <randomOrders> <threads> [params.txt] [key=value ...]
+
+#include "habitat.h"
+#include "resultstore.h"
+
+#include <thread>
+
+int main(int argc, char** argv)
+{
+    if (argc < 6)
+    {
+        cerr << "Usage: " << argv[0] << " <site> <h> <D> <randomOrders> <threads> [params.txt] [key=value ...]" << endl;
+        return 1;
+    }
+    
+    string site = argv[1];
+    double h = atof(argv[2]);
+    double D = atof(argv[3]);
+    int randomOrders = atoi(argv[4]);
+    int numThreads = atoi(argv[5]);
+    
+    if (numThreads <= 0)
+        numThreads = max(1u, thread::hardware_concurrency());
+    
+    Params par;
+    if (!readParams(argc - 5, argv + 5, par))
+        return 1;
+    printParams(par);
+    
+    //Gamma
+    
+    map<string, int> plantIndex;
+    map<string, int> insectIndex;
+    
+    int plantCount = 0, insectCount = 0, numPatch = 0;
+    
+    vector<vector<vector<double>>> gamma;
+    
+    loadGamma("interactions_" + site + "_patches.txt", plantIndex, insectIndex, plantCount, insectCount, numPatch, gamma);
+    
+    cout << "Number of plants: " << plantCount << endl;
+    cout << "Number of insects: " << insectCount << endl;
+    cout << "Number of patches: " << numPatch << endl;
+    
+    if (plantCount == 0 || insectCount == 0)
+        return 1;
+    
+    //Steady state before any habitat loss
+    
+    vector <vector<double>> p, v;
+    
+    initializeState(p, v, gamma, plantCount, insectCount, numPatch);
+    
+    ofstream dummy_p("/dev/null");
+    ofstream dummy_v("/dev/null");
+    findSteadyState(0.0, p, v, dummy_p, dummy_v, plantCount, insectCount, numPatch, gamma, par, h, D);
+    
+    //Orders: least abundant patch first, then random ones (order k shuffled with seed k)
+    
+    vector<vector<int>> orders = {patchRanking(p, v, plantCount, insectCount, numPatch)};
+    vector<string> labels = {"ordered 0"};
+    vector<unsigned> seeds = {0};
+    
+    for(int k=1 ; k<=randomOrders ; k++)
+    {
+        vector<int> order(numPatch);
+        for(int site=0 ; site<numPatch ; site++)
+            order[site] = site;
+        
+        mt19937 rng(k);
+        shuffle(order.begin(), order.end(), rng);
+        
+        orders.push_back(order);
+        labels.push_back("random " + to_string(k));
+        seeds.push_back(k);
+    }
+    
+    cout << "\n---Running " << orders.size() << " habitat-loss sequences on " << numThreads << " threads ---" << endl;
+    
+    vector<vector<ExtinctionStep>> curves = runHabitatLossExperiments(orders, p, v, gamma, par, h, plantCount, insectCount, numPatch, D, numThreads);
+    
+    for (size_t k=0 ; k<curves.size() ; k++)
+    {
+        cout << labels[k] << ": R (robustness) = " << robustnessIndex(curves[k]) << endl;
+        int strategy = (k == 0) ? STRATEGY_HABITAT_ORDERED : STRATEGY_HABITAT_RANDOM;
+        uint64_t tag = runTag(site, h, D, strategy, seeds[k], par, PRECISION_DOUBLE);
+        appendToStore("results.store", site, h, D, strategy, seeds[k], par, PRECISION_DOUBLE, curves[k], tag, true);
+    }
+    
+    writeHabitatLossResults(curves, labels, "habitatLoss.txt");
+    
+    cout << "Results in habitatLoss.txt" << endl;
+    
+    return 0;
+}
@@ -0,0 +1,73 @@
+//Stochastic experiment: extinction times under demographic noise, starting from the deterministic steady state
+//
+//  ./expStoch.exe <site> <h> <D> <replicates> <tMax> <seed> <threads> [params.txt] [key=value ...]
+
+#include "stochastic.h"
+
+#include <thread>
+
+int main(int argc, char** argv)
+{
+    if (argc < 8)
+    {
+        cerr << "Usage: " << argv[0] << " <site> <h> <D> <replicates> <tMax> <seed> <threads> [params.txt] [key=value ...]" << endl;
+        return 1;
+    }
+
+    string site = argv[1];
+    double h = atof(argv[2]);
+    double D = atof(argv[3]);
+    int replicates = atoi(argv[4]);
+    double tMax = atof(argv[5]);
+    unsigned seed = strtoul(argv[6], nullptr, 10);
+    int numThreads = atoi(argv[7]);
+
+    if (numThreads <= 0)
+        numThreads = max(1u, thread::hardware_concurrency());
+
+    Params par;
+    if (!readParams(argc - 7, argv + 7, par))
+        return 1;
+    printParams(par);
+
+    //Gamma
+
+    map<string, int> plantIndex;
+    map<string, int> insectIndex;
+
+    int plantCount = 0, insectCount = 0, numPatch = 0;
+
+    vector<vector<vector<double>>> gamma;
+
+    loadGamma("interactions_" + site + "_patches.txt", plantIndex, insectIndex, plantCount, insectCount, numPatch, gamma);
+
+    cout << "Number of plants: " << plantCount << endl;
+    cout << "Number of insects: " << insectCount << endl;
+
+    if (plantCount == 0 || insectCount == 0)
+        return 1;
+
+    vector<string> names = speciesNames(plantIndex, insectIndex, plantCount, insectCount);
+
+    //Deterministic steady state as initial condition
+
+    vector <vector<double>> p, v;
+
+    initializeState(p, v, gamma, plantCount, insectCount, numPatch);
+
+    ofstream dummy_p("/dev/null");
+    ofstream dummy_v("/dev/null");
+    findSteadyState(0.0, p, v, dummy_p, dummy_v, plantCount, insectCount, numPatch, gamma, par, h, D);
+
+    //Run
+
+    cout << "Running " << replicates << " replicates up to t = " << tMax << " on " << numThreads << " threads..." << endl;
+
+    vector<vector<double>> times = runStochasticReplicates(p, v, gamma, par, plantCount, insectCount, numPatch, D, tMax, replicates, seed, numThreads);
+
+    writeExtinctionTimes(times, names, plantCount, tMax, seed, "extinctionTimes.txt", "extinctionTimesRaw.txt");
+
+    cout << "Results in extinctionTimes.txt and extinctionTimesRaw.txt" << endl;
+
+    return 0;
+}
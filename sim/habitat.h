@@ -0,0 +1,25 @@
+#ifndef HABITAT_H
+#define HABITAT_H
+
+#include "model.h"
+
+//Habitat-loss experiment: patches are destroyed one at a time and, after each loss, the community is
+//taken to its new steady state starting from the previous one. Each step reports the same metrics as
+//the extinction experiments, with numExtinctions counting the patches removed.
+
+//Deletes a patch from the state and gamma in place; numPatch goes down by one
+void removePatch(int patch, vector<vector<double>>& p, vector<vector<double>>& v, vector<vector<vector<double>>>& gamma, int& numPatch);
+
+//Patches by increasing total abundance (plants and insects) of the state
+vector<int> patchRanking(const vector<vector<double>>& p, const vector<vector<double>>& v, int plantCount, int insectCount, int numpatch);
+
+//Removes the patches in order (original patch numbers) starting from the steady state p, v
+vector<ExtinctionStep> runHabitatLossSequence(const vector<int>& order, const vector<vector<double>>& p, const vector<vector<double>>& v, const vector<vector<vector<double>>>& gamma, const Params& par, double h, int plantCount, int insectCount, int numpatch, double D);
+
+//Runs every order on numThreads threads; curve k is the one of orders[k]
+vector<vector<ExtinctionStep>> runHabitatLossExperiments(const vector<vector<int>>& orders, const vector<vector<double>>& p, const vector<vector<double>>& v, const vector<vector<vector<double>>>& gamma, const Params& par, double h, int plantCount, int insectCount, int numpatch, double D, int numThreads);
+
+//One table for all the curves, each row preceded by the label of its order
+void writeHabitatLossResults(const vector<vector<ExtinctionStep>>& curves, const vector<string>& labels, const string& resultsFile);
+
+#endif
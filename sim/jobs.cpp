@@ -0,0 +1,456 @@
+//Job launcher: runs a grid of extinction experiments (site x D x strategy x seed) with N worker processes
+//
+//  ./jobs.exe init  <queue> <grid.txt>        one job per grid line: "site h D strategy seed [key=value ...]"
+//  ./jobs.exe run   <queue> <workers>         workers claim jobs from <queue>/pending until it is empty
+//  ./jobs.exe merge <queue> <table.txt>       collects <queue>/done into a single table
+//
+//strategy is ordered|random; the optional key=value tokens override model parameters for that job,
+//and a "float" token runs it with single-precision state.
+//
+//A job is claimed by renaming pending/<id> to claimed/<id>.<pid> and committed by renaming its output
+//into done/<id>; both are atomic, so a crash never leaves half a job in done/. Workers hold a lock on their
+//claim while running it, so on restart finished jobs are skipped and unlocked claims go back to pending.
+//
+//Every finished curve is also appended to the columnar store <queue>/store (see resultstore.h), tagged
+//with the job id so a job re-run after a crash between the two commits is not stored twice.
+
+#include "model.h"
+#include "resultstore.h"
+
+#include <filesystem>
+#include <charconv>
+#include <cerrno>
+#include <cstdio>
+#include <csignal>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <sys/file.h>
+
+namespace fs = std::filesystem;
+
+struct Job
+{
+    string site;
+    double h;
+    double D;
+    string strategy;
+    unsigned seed;
+    vector<string> overrides;
+    Params par;
+    bool single = false;
+};
+
+bool parseJob(const string& line, Job& job)
+{
+    istringstream iss(line);
+    if (!(iss >> job.site >> job.h >> job.D >> job.strategy >> job.seed))
+        return false;
+
+    string token;
+    while (iss >> token)
+    {
+        if (token == "float")
+            job.single = true;
+        else if (!parseParam(token, job.par))
+            return false;
+        job.overrides.push_back(token);
+    }
+
+    return job.strategy == "ordered" || job.strategy == "random";
+}
+
+//Shortest text that reads back as the same double, so grid values that differ in any digit get different ids
+string exactNumber(double value)
+{
+    char buffer[32];
+    auto result = to_chars(buffer, buffer + sizeof(buffer), value);
+    return string(buffer, result.ptr);
+}
+
+string jobSpec(const Job& job)
+{
+    ostringstream oss;
+    oss << job.site << " " << exactNumber(job.h) << " " << exactNumber(job.D) << " " << job.strategy << " " << job.seed;
+    for (const auto& token : job.overrides)
+        oss << " " << token;
+    return oss.str();
+}
+
+string jobId(const Job& job)
+{
+    ostringstream oss;
+    oss << job.site << "_h" << exactNumber(job.h) << "_D" << exactNumber(job.D) << "_" << job.strategy << "_" << job.seed;
+    for (const auto& token : job.overrides)
+        oss << "_" << token;
+    return oss.str();
+}
+
+//Flush a file to disk so that a rename after it is durable
+void syncFile(const fs::path& path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd >= 0)
+    {
+        fsync(fd);
+        close(fd);
+    }
+}
+
+void writeFileAtomic(const fs::path& path, const string& content)
+{
+    fs::path tmp = path;
+    tmp += ".tmp." + to_string(getpid());
+
+    ofstream out(tmp);
+    out << content;
+    out.close();
+
+    syncFile(tmp);
+    fs::rename(tmp, path);
+    syncFile(path.parent_path());
+}
+
+string readFile(const fs::path& path)
+{
+    ifstream in(path);
+    ostringstream oss;
+    oss << in.rdbuf();
+    return oss.str();
+}
+
+bool isTemporary(const fs::path& path)
+{
+    return path.filename().string().find(".tmp.") != string::npos;
+}
+
+void makeQueue(const fs::path& queue)
+{
+    for (const char* dir : {"pending", "claimed", "done", "failed", "logs"})
+        fs::create_directories(queue / dir);
+}
+
+int initQueue(const fs::path& queue, const string& gridFile)
+{
+    ifstream grid(gridFile);
+    if (!grid)
+    {
+        cerr << "Cannot open grid " << gridFile << endl;
+        return 1;
+    }
+
+    makeQueue(queue);
+
+    //Claims currently in flight, by job id
+    map<string, int> claimed;
+    for (const auto& entry : fs::directory_iterator(queue / "claimed"))
+    {
+        string name = entry.path().filename().string();
+        claimed[name.substr(0, name.rfind('.'))]++;
+    }
+
+    int added = 0, skipped = 0;
+    string line;
+
+    while (getline(grid, line))
+    {
+        Job job;
+        if (line.empty() || line[0] == '#' || !parseJob(line, job))
+            continue;
+
+        string id = jobId(job);
+
+        if (fs::exists(queue / "done" / id) || fs::exists(queue / "pending" / id) || claimed.count(id))
+        {
+            skipped++;
+            continue;
+        }
+
+        writeFileAtomic(queue / "pending" / id, jobSpec(job) + "\n");
+        added++;
+    }
+
+    cout << added << " jobs queued, " << skipped << " already queued or done." << endl;
+    return 0;
+}
+
+//The lock is released by the kernel when its owner exits, however it dies
+int lockClaim(const fs::path& claim, bool wait)
+{
+    int fd = open(claim.c_str(), O_RDONLY);
+    if (fd < 0)
+        return -1;
+    if (flock(fd, wait ? LOCK_EX : LOCK_EX | LOCK_NB) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+//Give back the claims of workers that are no longer running
+void recoverClaims(const fs::path& queue)
+{
+    for (const auto& entry : fs::directory_iterator(queue / "claimed"))
+    {
+        string name = entry.path().filename().string();
+        size_t dot = name.rfind('.');
+        if (dot == string::npos || isTemporary(entry.path()))
+            continue;
+
+        string id = name.substr(0, dot);
+        pid_t owner = atoi(name.c_str() + dot + 1);
+
+        int fd = lockClaim(entry.path(), false);
+        if (fd < 0)
+            continue;
+
+        //Still locked, so a concurrent recovery cannot move the same claim
+        error_code ec;
+        if (fs::exists(queue / "done" / id))
+            fs::remove(entry.path(), ec);
+        else
+        {
+            fs::rename(entry.path(), queue / "pending" / id, ec);
+            if (!ec)
+                cout << "Requeued " << id << " (worker " << owner << " is gone)" << endl;
+        }
+        close(fd);
+    }
+
+    //Leftovers of outputs that were never committed
+    for (const char* dir : {"claimed", "done"})
+        for (const auto& entry : fs::directory_iterator(queue / dir))
+            if (isTemporary(entry.path()))
+            {
+                string name = entry.path().filename().string();
+                pid_t owner = atoi(name.c_str() + name.rfind('.') + 1);
+                if (kill(owner, 0) != 0 && errno == ESRCH)
+                    fs::remove(entry.path());
+            }
+}
+
+template<typename T>
+bool runExperiment(const Job& job, vector<ExtinctionStep>& curve)
+{
+    map<string, int> plantIndex;
+    map<string, int> insectIndex;
+    int plantCount = 0, insectCount = 0, numPatch = 0;
+    vector<vector<vector<T>>> gamma;
+
+    loadGamma("interactions_" + job.site + "_patches.txt", plantIndex, insectIndex, plantCount, insectCount, numPatch, gamma);
+
+    if (plantCount == 0 || insectCount == 0)
+        return false;
+
+    vector<vector<T>> p, v;
+    initializeState(p, v, gamma, plantCount, insectCount, numPatch);
+
+    ofstream dummy_p("/dev/null");
+    ofstream dummy_v("/dev/null");
+    findSteadyState(0.0, p, v, dummy_p, dummy_v, plantCount, insectCount, numPatch, gamma, job.par, job.h, job.D);
+
+    if (job.strategy == "ordered")
+        curve = runExtinctionExperiment(p, v, gamma, job.par, job.h, plantCount, insectCount, numPatch, job.D);
+    else
+        curve = runRandomExtinctionExperiment(p, v, gamma, job.par, job.h, plantCount, insectCount, numPatch, job.D, job.seed);
+
+    return true;
+}
+
+bool runJob(const fs::path& queue, const string& id, const fs::path& claim)
+{
+    Job job;
+    string spec = readFile(claim);
+    if (!parseJob(spec, job))
+        return false;
+
+    vector<ExtinctionStep> curve;
+    bool ok = job.single ? runExperiment<float>(job, curve) : runExperiment<double>(job, curve);
+    if (!ok)
+        return false;
+
+    int strategy = job.strategy == "ordered" ? STRATEGY_ORDERED : STRATEGY_RANDOM;
+    int precision = job.single ? PRECISION_FLOAT : PRECISION_DOUBLE;
+    if (!appendToStore((queue / "store").string(), job.site, job.h, job.D, strategy, job.seed, job.par, precision, curve, storeTag(id), false))
+        return false;
+
+    fs::path results = queue / "claimed" / (id + ".tmp." + to_string(getpid()));
+    writeExtinctionResults(curve, results.string(), "/dev/null");
+
+    //Commit: the job line followed by the results table
+    writeFileAtomic(queue / "done" / id, "# " + jobSpec(job) + "\n" + readFile(results));
+    fs::remove(results);
+
+    return true;
+}
+
+void worker(const fs::path& queue)
+{
+    string suffix = "." + to_string(getpid());
+
+    while (true)
+    {
+        vector<fs::path> pending;
+        for (const auto& entry : fs::directory_iterator(queue / "pending"))
+            if (!isTemporary(entry.path()))
+                pending.push_back(entry.path());
+
+        if (pending.empty())
+            break;
+
+        sort(pending.begin(), pending.end());
+
+        for (const auto& job : pending)
+        {
+            string id = job.filename().string();
+            fs::path claim = queue / "claimed" / (id + suffix);
+
+            //Locked before the rename (the lock follows the inode), so recoverClaims never sees
+            //this claim unlocked while it runs
+            int lock = lockClaim(job, false);
+            if (lock < 0)
+                continue; //Another worker is claiming it
+
+            error_code ec;
+            fs::rename(job, claim, ec);
+            if (ec)
+            {
+                close(lock);
+                continue; //Another worker got it first
+            }
+
+            fflush(stdout);
+            freopen((queue / "logs" / (id + ".log")).c_str(), "w", stdout);
+
+            try
+            {
+                if (runJob(queue, id, claim))
+                    fs::remove(claim);
+                else
+                    fs::rename(claim, queue / "failed" / id);
+            }
+            catch (const fs::filesystem_error& e)
+            {
+                cerr << "Job " << id << ": " << e.what() << endl;
+            }
+
+            close(lock);
+        }
+    }
+
+    fflush(stdout);
+}
+
+int runQueue(const fs::path& queue, int numWorkers)
+{
+    makeQueue(queue);
+    recoverClaims(queue);
+
+    cout << "Launching " << numWorkers << " workers..." << endl;
+
+    int running = 0;
+    for (int w=0 ; w<numWorkers ; w++)
+    {
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            worker(queue);
+            _exit(0);
+        }
+        if (pid > 0)
+            running++;
+    }
+
+    while (running > 0)
+    {
+        int status;
+        pid_t pid = wait(&status);
+        if (pid < 0)
+            break;
+        running--;
+
+        //A crashed worker leaves its claim behind for the next run; replace it so the grid keeps moving
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        {
+            cout << "Worker " << pid << " died, starting a new one." << endl;
+            pid_t replacement = fork();
+            if (replacement == 0)
+            {
+                worker(queue);
+                _exit(0);
+            }
+            if (replacement > 0)
+                running++;
+        }
+    }
+
+    int left = 0, failed = 0;
+    for (const auto& entry : fs::directory_iterator(queue / "claimed"))
+        if (!isTemporary(entry.path()))
+            left++;
+    for (auto it = fs::directory_iterator(queue / "failed") ; it != fs::directory_iterator() ; ++it)
+        failed++;
+
+    cout << "Done. " << left << " jobs to retry on the next run, " << failed << " failed." << endl;
+    return left > 0 ? 1 : 0;
+}
+
+int mergeQueue(const fs::path& queue, const string& tableFile)
+{
+    vector<fs::path> done;
+    for (const auto& entry : fs::directory_iterator(queue / "done"))
+        if (!isTemporary(entry.path()))
+            done.push_back(entry.path());
+
+    sort(done.begin(), done.end());
+
+    ostringstream table;
+    table << "# Site h D Strategy Seed m r Kp Kv ha d alpha Precision Num_Extinctions Robustness_Ratio Surv_Plants Surv_Insects Pollination_Service Gini_Plants Gini_Insects" << endl;
+
+    for (const auto& path : done)
+    {
+        ifstream in(path);
+        string line, spec;
+
+        Job job;
+        getline(in, spec);
+        if (spec.size() < 2 || !parseJob(spec.substr(2), job))
+            continue;
+
+        //Parameters are written out in full so every row has the same columns
+        ostringstream key;
+        key << job.site << " " << exactNumber(job.h) << " " << exactNumber(job.D) << " " << job.strategy << " " << job.seed << " "
+            << job.par.m << " " << job.par.r << " " << job.par.Kp << " " << job.par.Kv << " " << job.par.ha << " " << job.par.d << " " << job.par.alpha << " " << (job.single ? "float" : "double");
+
+        while (getline(in, line))
+            if (!line.empty() && line[0] != '#')
+                table << key.str() << " " << line << endl;
+    }
+
+    writeFileAtomic(fs::absolute(tableFile), table.str());
+    cout << done.size() << " jobs merged into " << tableFile << endl;
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc != 4)
+    {
+        cerr << "Usage: " << argv[0] << " init <queue> <grid.txt> | run <queue> <workers> | merge <queue> <table.txt>" << endl;
+        return 1;
+    }
+
+    string mode = argv[1];
+    fs::path queue = argv[2];
+
+    if (mode == "init")
+        return initQueue(queue, argv[3]);
+    if (mode == "run")
+        return runQueue(queue, atoi(argv[3]));
+    if (mode == "merge")
+        return mergeQueue(queue, argv[3]);
+
+    cerr << "Unknown mode " << mode << endl;
+    return 1;
+}
@@ -0,0 +1,183 @@
+//C interface to the model (see metapop.h)
+
+#include "model.h"
+#include "metapop.h"
+
+struct mp_model
+{
+    map<string, int> plantIndex;
+    map<string, int> insectIndex;
+    vector<string> plantNames;
+    vector<string> insectNames;
+    int plantCount = 0, insectCount = 0, numPatch = 0;
+    vector<vector<vector<double>>> gamma;
+    vector<vector<double>> p, v;
+    Params par;
+    bool verbose = false;
+};
+
+extern "C" {
+
+mp_model* mp_load(const char* filename)
+{
+    mp_model* model = new mp_model;
+
+    //A stream without a buffer discards what is written to it. Each call has its own, so calls on
+    //different models from different threads share no output state
+    ostream quiet(nullptr);
+    loadGamma(filename, model->plantIndex, model->insectIndex, model->plantCount, model->insectCount, model->numPatch, model->gamma, quiet);
+
+    if (model->plantCount == 0 || model->insectCount == 0)
+    {
+        delete model;
+        return nullptr;
+    }
+
+    model->plantNames.resize(model->plantCount);
+    model->insectNames.resize(model->insectCount);
+    for (const auto& item : model->plantIndex)
+        model->plantNames[item.second] = item.first;
+    for (const auto& item : model->insectIndex)
+        model->insectNames[item.second] = item.first;
+
+    initializeState(model->p, model->v, model->gamma, model->plantCount, model->insectCount, model->numPatch);
+    return model;
+}
+
+void mp_free(mp_model* model)
+{
+    delete model;
+}
+
+int mp_plant_count(const mp_model* model)
+{
+    return model->plantCount;
+}
+
+int mp_insect_count(const mp_model* model)
+{
+    return model->insectCount;
+}
+
+int mp_patch_count(const mp_model* model)
+{
+    return model->numPatch;
+}
+
+const char* mp_plant_name(const mp_model* model, int plant)
+{
+    if (plant < 0 || plant >= model->plantCount)
+        return nullptr;
+    return model->plantNames[plant].c_str();
+}
+
+const char* mp_insect_name(const mp_model* model, int insect)
+{
+    if (insect < 0 || insect >= model->insectCount)
+        return nullptr;
+    return model->insectNames[insect].c_str();
+}
+
+void mp_get_gamma(const mp_model* model, double* gamma)
+{
+    for (int site=0 ; site<model->numPatch ; site++)
+        for (int i=0 ; i<model->plantCount ; i++)
+            for (int j=0 ; j<model->insectCount ; j++)
+                *gamma++ = model->gamma[site][i][j];
+}
+
+int mp_set_param(mp_model* model, const char* key, double value)
+{
+    return setParam(model->par, key, value) ? 0 : -1;
+}
+
+double mp_get_param(const mp_model* model, const char* key)
+{
+    string name = key;
+    const Params& par = model->par;
+
+    if (name == "m") return par.m;
+    if (name == "r") return par.r;
+    if (name == "Kp") return par.Kp;
+    if (name == "Kv") return par.Kv;
+    if (name == "ha") return par.ha;
+    if (name == "d") return par.d;
+    if (name == "alpha") return par.alpha;
+
+    return NAN;
+}
+
+void mp_set_verbose(mp_model* model, int verbose)
+{
+    model->verbose = (verbose != 0);
+}
+
+void mp_set_threads(int threads)
+{
+    setIntegratorThreads(threads);
+}
+
+void mp_reset(mp_model* model)
+{
+    initializeState(model->p, model->v, model->gamma, model->plantCount, model->insectCount, model->numPatch);
+}
+
+void mp_get_state(const mp_model* model, double* plants, double* insects)
+{
+    for (int i=0 ; i<model->plantCount ; i++)
+        for (int site=0 ; site<model->numPatch ; site++)
+            *plants++ = model->p[i][site];
+
+    for (int i=0 ; i<model->insectCount ; i++)
+        for (int site=0 ; site<model->numPatch ; site++)
+            *insects++ = model->v[i][site];
+}
+
+void mp_set_state(mp_model* model, const double* plants, const double* insects)
+{
+    for (int i=0 ; i<model->plantCount ; i++)
+        for (int site=0 ; site<model->numPatch ; site++)
+            model->p[i][site] = *plants++;
+
+    for (int i=0 ; i<model->insectCount ; i++)
+        for (int site=0 ; site<model->numPatch ; site++)
+            model->v[i][site] = *insects++;
+}
+
+void mp_steady_state(mp_model* model, double h, double D)
+{
+    ostream quiet(nullptr);
+    ostream& log = model->verbose ? cout : quiet;
+
+    ofstream dummy_p("/dev/null");
+    ofstream dummy_v("/dev/null");
+    findSteadyState(0.0, model->p, model->v, dummy_p, dummy_v, model->plantCount, model->insectCount, model->numPatch, model->gamma, model->par, h, D, log);
+}
+
+int mp_extinction(mp_model* model, double h, double D, int random, unsigned seed, double* rows, int maxRows)
+{
+    ostream quiet(nullptr);
+    ostream& log = model->verbose ? cout : quiet;
+
+    vector<ExtinctionStep> curve;
+    if (random)
+        curve = runRandomExtinctionExperiment(model->p, model->v, model->gamma, model->par, h, model->plantCount, model->insectCount, model->numPatch, D, seed, log);
+    else
+        curve = runExtinctionExperiment(model->p, model->v, model->gamma, model->par, h, model->plantCount, model->insectCount, model->numPatch, D, log);
+
+    for (int k=0 ; k<(int)curve.size() && k<maxRows ; k++)
+    {
+        const ExtinctionStep& step = curve[k];
+        *rows++ = step.numExtinctions;
+        *rows++ = step.robustness;
+        *rows++ = step.survPlants;
+        *rows++ = step.survInsects;
+        *rows++ = step.pollinationService;
+        *rows++ = step.giniP;
+        *rows++ = step.giniV;
+    }
+
+    return curve.size();
+}
+
+}
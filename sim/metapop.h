@@ -0,0 +1,67 @@
+/* C interface to the metapopulation model, for use from Python (metapop.py) or any other language.
+ *
+ *   g++ -O2 -shared -fPIC -pthread -o libmetapop.so metapop.cpp model.cpp
+ *
+ * States are exchanged as row-major arrays: plants are plantCount x numPatch and insects are
+ * insectCount x numPatch, in the order species first appear in the interactions file. The model
+ * keeps its own (per-species) state, so mp_get_state, mp_set_state and mp_get_gamma copy the data
+ * into or out of the caller's buffers on every call; nothing is shared with them afterwards.
+ * Zero-copy access is not provided: the engine stores each species as its own row, and handing out
+ * a view would need it to keep the state in one contiguous buffer.
+ * Calls on different models may run concurrently; each call silences or prints its own output.
+ * Functions returning int give 0 on success and -1 on error. */
+
+#ifndef METAPOP_H
+#define METAPOP_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct mp_model mp_model;
+
+/* Columns of each row written by mp_extinction */
+#define MP_EXTINCTION_COLUMNS 7
+
+/* Loads an interactions file ("patch plant insect weight" lines) and sets the initial condition */
+mp_model* mp_load(const char* filename);
+void mp_free(mp_model* model);
+
+int mp_plant_count(const mp_model* model);
+int mp_insect_count(const mp_model* model);
+int mp_patch_count(const mp_model* model);
+const char* mp_plant_name(const mp_model* model, int plant);
+const char* mp_insect_name(const mp_model* model, int insect);
+
+/* gamma as numPatch x plantCount x insectCount */
+void mp_get_gamma(const mp_model* model, double* gamma);
+
+/* Parameters m, r, Kp, Kv, ha, d, alpha */
+int mp_set_param(mp_model* model, const char* key, double value);
+double mp_get_param(const mp_model* model, const char* key);
+
+/* Model output on stdout is silenced unless verbose is set */
+void mp_set_verbose(mp_model* model, int verbose);
+
+/* Threads used to evaluate each RK4 step, shared by all models (1 by default) */
+void mp_set_threads(int threads);
+
+/* Back to the initial condition: 100 plants and 500 insects wherever they have an interaction */
+void mp_reset(mp_model* model);
+void mp_get_state(const mp_model* model, double* plants, double* insects);
+void mp_set_state(mp_model* model, const double* plants, const double* insects);
+
+/* Integrates the current state to its steady state */
+void mp_steady_state(mp_model* model, double h, double D);
+
+/* Runs an extinction experiment from the current state, which is left unchanged. Writes at most
+ * maxRows rows of MP_EXTINCTION_COLUMNS (Num_Extinctions Robustness_Ratio Surv_Plants Surv_Insects
+ * Pollination_Service Gini_Plants Gini_Insects) and returns the number of rows of the curve,
+ * which is never more than plantCount + 1. */
+int mp_extinction(mp_model* model, double h, double D, int random, unsigned seed, double* rows, int maxRows);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
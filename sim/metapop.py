@@ -0,0 +1,153 @@
+"""
+Enlace Python con el modelo C++ (libmetapop.so, ver metapop.h).
+
+Compilar la librería una vez:
+    g++ -O2 -shared -fPIC -pthread -o libmetapop.so metapop.cpp model.cpp
+
+Uso:
+    from metapop import Model
+    model = Model('interactions_Dolebury_Warren_patches.txt')
+    model.set_params(r=2.0, Kv=1000)
+    model.steady_state(h=0.01, D=1.0)
+    p, v = model.state()              # arrays (especies x parches)
+    curve = model.extinction(h=0.01, D=1.0)
+
+Los arrays de NumPy se pasan a C como punteros (sin ficheros de texto y sin
+lanzar procesos). El modelo guarda su propio estado, así que state(),
+set_state() y gamma() copian los datos en cada llamada: modificar el array
+devuelto no cambia el modelo. No hay acceso sin copia: el motor guarda cada
+especie en su propia fila, y una vista exigiría un único buffer contiguo.
+
+Las llamadas sobre modelos distintos pueden hacerse desde hilos distintos:
+cada llamada silencia (o muestra) su propia salida.
+"""
+
+import ctypes
+import os
+
+import numpy as np
+
+EXTINCTION_COLUMNS = ['K', 'Robustez', 'SurvPlants', 'SurvInsects', 'Service', 'GiniP', 'GiniI']
+
+_LIB_PATH = os.path.join(os.path.dirname(os.path.abspath(__file__)), 'libmetapop.so')
+_lib = None
+
+_double_p = np.ctypeslib.ndpointer(dtype=np.float64, flags='C_CONTIGUOUS')
+
+
+def _load_library(path=_LIB_PATH):
+    global _lib
+    if _lib is not None:
+        return _lib
+
+    lib = ctypes.CDLL(path)
+
+    lib.mp_load.restype = ctypes.c_void_p
+    lib.mp_load.argtypes = [ctypes.c_char_p]
+    lib.mp_free.argtypes = [ctypes.c_void_p]
+
+    for name in ('mp_plant_count', 'mp_insect_count', 'mp_patch_count'):
+        getattr(lib, name).restype = ctypes.c_int
+        getattr(lib, name).argtypes = [ctypes.c_void_p]
+
+    for name in ('mp_plant_name', 'mp_insect_name'):
+        getattr(lib, name).restype = ctypes.c_char_p
+        getattr(lib, name).argtypes = [ctypes.c_void_p, ctypes.c_int]
+
+    lib.mp_get_gamma.argtypes = [ctypes.c_void_p, _double_p]
+
+    lib.mp_set_param.restype = ctypes.c_int
+    lib.mp_set_param.argtypes = [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_double]
+    lib.mp_get_param.restype = ctypes.c_double
+    lib.mp_get_param.argtypes = [ctypes.c_void_p, ctypes.c_char_p]
+
+    lib.mp_set_verbose.argtypes = [ctypes.c_void_p, ctypes.c_int]
+    lib.mp_set_threads.argtypes = [ctypes.c_int]
+    lib.mp_reset.argtypes = [ctypes.c_void_p]
+    lib.mp_get_state.argtypes = [ctypes.c_void_p, _double_p, _double_p]
+    lib.mp_set_state.argtypes = [ctypes.c_void_p, _double_p, _double_p]
+
+    lib.mp_steady_state.argtypes = [ctypes.c_void_p, ctypes.c_double, ctypes.c_double]
+
+    lib.mp_extinction.restype = ctypes.c_int
+    lib.mp_extinction.argtypes = [ctypes.c_void_p, ctypes.c_double, ctypes.c_double, ctypes.c_int,
+                                  ctypes.c_uint, _double_p, ctypes.c_int]
+
+    _lib = lib
+    return lib
+
+
+class Model:
+    """Una red de interacciones cargada en el motor C++, con su estado actual."""
+
+    def __init__(self, filename, verbose=False):
+        self._lib = _load_library()
+        self._handle = self._lib.mp_load(filename.encode())
+        if not self._handle:
+            raise IOError(f"No se pudo cargar la red de {filename}")
+        self._lib.mp_set_verbose(self._handle, int(verbose))
+
+        self.plant_count = self._lib.mp_plant_count(self._handle)
+        self.insect_count = self._lib.mp_insect_count(self._handle)
+        self.patch_count = self._lib.mp_patch_count(self._handle)
+
+        self.plant_names = [self._lib.mp_plant_name(self._handle, i).decode() for i in range(self.plant_count)]
+        self.insect_names = [self._lib.mp_insect_name(self._handle, i).decode() for i in range(self.insect_count)]
+
+    def __del__(self):
+        if getattr(self, '_handle', None):
+            self._lib.mp_free(self._handle)
+            self._handle = None
+
+    # --- Parámetros ---
+    def set_params(self, **params):
+        for key, value in params.items():
+            if self._lib.mp_set_param(self._handle, key.encode(), float(value)) != 0:
+                raise KeyError(f"Parámetro desconocido: {key}")
+
+    def get_param(self, key):
+        return self._lib.mp_get_param(self._handle, key.encode())
+
+    # --- Red ---
+    def gamma(self):
+        """Pesos de interacción (parches x plantas x insectos)."""
+        out = np.empty((self.patch_count, self.plant_count, self.insect_count))
+        self._lib.mp_get_gamma(self._handle, out)
+        return out
+
+    # --- Estado ---
+    def reset(self):
+        self._lib.mp_reset(self._handle)
+
+    def state(self):
+        """Copia de las abundancias actuales: (plantas x parches, insectos x parches)."""
+        p = np.empty((self.plant_count, self.patch_count))
+        v = np.empty((self.insect_count, self.patch_count))
+        self._lib.mp_get_state(self._handle, p, v)
+        return p, v
+
+    def set_state(self, p, v):
+        p = np.ascontiguousarray(p, dtype=np.float64).reshape(self.plant_count, self.patch_count)
+        v = np.ascontiguousarray(v, dtype=np.float64).reshape(self.insect_count, self.patch_count)
+        self._lib.mp_set_state(self._handle, p, v)
+
+    # --- Dinámica ---
+    def steady_state(self, h, D):
+        self._lib.mp_steady_state(self._handle, h, D)
+        return self.state()
+
+    def extinction(self, h, D, random=False, seed=42):
+        """Experimento de extinción desde el estado actual: una fila por paso (ver EXTINCTION_COLUMNS)."""
+        rows = np.empty((self.plant_count + 1, len(EXTINCTION_COLUMNS)))
+        n = self._lib.mp_extinction(self._handle, h, D, int(random), seed, rows, rows.shape[0])
+        return rows[:n]
+
+
+def set_threads(threads):
+    """Hilos con los que se evalúa cada paso de RK4 (para redes grandes); afecta a todos los modelos."""
+    _load_library().mp_set_threads(threads)
+
+
+def robustness(curve):
+    """R: media de la robustez a lo largo de la curva de extinción."""
+    return float(np.mean(curve[:, 1]))
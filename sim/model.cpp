@@ -2,7 +2,13 @@
 
 #include "model.h"
 
-bool plantExistsInPatch(int plantID, int site, int insectCount, const vector<vector<vector<double>>>& gamma)
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+template<typename T>
+bool plantExistsInPatch(int plantID, int site, int insectCount, const vector<vector<vector<T>>>& gamma)
 {
     for (int j = 0; j < insectCount; ++j) {
         if (gamma[site][plantID][j] > 0.0) {
@@ -12,7 +18,8 @@ bool plantExistsInPatch(int plantID, int site, int insectCount, const vector<vec
     return false;
 }
 
-bool insectExistsInPatch(int insectID, int site, int plantCount, const vector<vector<vector<double>>>& gamma)
+template<typename T>
+bool insectExistsInPatch(int insectID, int site, int plantCount, const vector<vector<vector<T>>>& gamma)
 {
     for (int i = 0; i < plantCount; ++i) {
         if (gamma[site][i][insectID] > 0.0) {
@@ -22,61 +29,107 @@ bool insectExistsInPatch(int insectID, int site, int plantCount, const vector<ve
     return false; 
 }
 
-void evaluaFp(double p, const vector<vector<double>>& v, double &fp, const vector<vector<vector<double>>>& gamma, int pindex, int site, int insectCount)
+//The state and gamma can be stored in float to halve memory and bandwidth on large ensembles;
+//reductions (sumden, dispersal, RK4 combination) are always accumulated in double. Convergence is judged
+//on the unrounded increments of the cells a step still changes: in float, a cell whose increment rounds
+//to nothing has settled as far as the stored state can, and a state where no cell changes is stationary.
+
+//Mutualistic gain. Specialised at compile time for a linear response (ha == 0) and for alpha == 1,
+//so the common cases pay nothing for the parameters being runtime values. The specialisations give
+//the same numbers as the general form, they only skip the multiplications by 1 and divisions by 1.
+template<bool LINEAR, bool UNIT_ALPHA>
+inline double response(double sumden, const Params& par)
+{
+    if (!UNIT_ALPHA)
+        sumden *= par.alpha;
+    
+    if (LINEAR)
+        return sumden;
+    
+    return sumden / (1.0 + (par.ha*sumden));
+}
+
+double functionalResponse(double sumden, const Params& par)
+{
+    return response<false, false>(sumden, par);
+}
+
+template<typename T, bool LINEAR, bool UNIT_ALPHA>
+inline void evaluaFpKernel(T p, const vector<vector<T>>& v, T &fp, const vector<vector<vector<T>>>& gamma, const Params& par, int pindex, int site, int insectCount)
 {
     fp = 0.0;
     double sumden = 0.0;
     
+    //A zero plant (absent from the patch, removed or cascaded) stays zero: its gain is not needed
+    if (p == 0.0)
+        return;
+    
     for(int i=0 ; i<insectCount ; i++)
         sumden += gamma[site][pindex][i] * v[i][site];
-        
-    sumden *= alpha;
     
-    double sum = sumden / (1.0 + (ha*sumden)); 
+    double sum = response<LINEAR, UNIT_ALPHA>(sumden, par);
         
-    fp = p*(-m-((r*p)/Kp) + sum); 
+    fp = p*(-par.m-((par.r*p)/par.Kp) + sum); 
     return;
 }
 
-void evaluaFv(const vector<vector<double>>& p, const vector<vector<double>>& v, double &fv, const vector<vector<vector<double>>>& gamma, int vindex, int site, int plantCount, int numPatch, double D)
+template<typename T, bool LINEAR, bool UNIT_ALPHA>
+inline void evaluaFvKernel(const vector<vector<T>>& p, const vector<vector<T>>& v, T &fv, const vector<vector<vector<T>>>& gamma, const Params& par, int vindex, int site, int plantCount, int numPatch, double D)
 {
     fv = 0.0;
     double sum = 0.0, sumD = 0.0, sumden = 0.0;
     
-    for(int i=0 ; i<plantCount ; i++)
-        sumden += gamma[site][i][vindex] * p[i][site];
- 
-    sumden *= alpha;
-    
-    sum +=  sumden / (1.0 + (ha*sumden));
+    //The gain is multiplied by the insect's own abundance, so a zero one only feels dispersal
+    if (v[vindex][site] != 0.0)
+    {
+        for(int i=0 ; i<plantCount ; i++)
+            sumden += gamma[site][i][vindex] * p[i][site];
+        
+        sum += response<LINEAR, UNIT_ALPHA>(sumden, par);
+    }
         
     for( int i=0 ; i<numPatch ; i++)
         if ( i!=site)
-            sumD += (v[vindex][i]-v[vindex][site]); 
+            sumD += ((double)v[vindex][i]-v[vindex][site]); 
             
-    fv = v[vindex][site]*(-1.0*d*(1.0+(v[vindex][site]/Kv)) + sum) + (D*sumD); 
+    fv = v[vindex][site]*(-1.0*par.d*(1.0+(v[vindex][site]/par.Kv)) + sum) + (D*sumD); 
     return;
 }
 
-void rungekutta(vector<vector<double>>& p, vector<vector<double>>& v, const vector<vector<vector<double>>>& gamma, double h, int plantCount, int insectCount, int numPatch, double D)
+template<typename T>
+void evaluaFp(T p, const vector<vector<T>>& v, T &fp, const vector<vector<vector<T>>>& gamma, const Params& par, int pindex, int site, int insectCount)
+{
+    evaluaFpKernel<T, false, false>(p, v, fp, gamma, par, pindex, site, insectCount);
+}
+
+template<typename T>
+void evaluaFv(const vector<vector<T>>& p, const vector<vector<T>>& v, T &fv, const vector<vector<vector<T>>>& gamma, const Params& par, int vindex, int site, int plantCount, int numPatch, double D)
+{
+    evaluaFvKernel<T, false, false>(p, v, fv, gamma, par, vindex, site, plantCount, numPatch, D);
+}
+
+//Returns the largest increment, before rounding, among the cells the step changed
+template<typename T, bool LINEAR, bool UNIT_ALPHA>
+double rungekuttaKernel(vector<vector<T>>& p, vector<vector<T>>& v, const vector<vector<vector<T>>>& gamma, const Params& par, double h, int plantCount, int insectCount, int numPatch, double D)
 {   
     double sumav, sumap;
+    double max_delta = 0.0;
     
-    vector<vector<double>> k1v(insectCount, vector<double>(numPatch));
-    vector<vector<double>> k2v(insectCount, vector<double>(numPatch));
-    vector<vector<double>> k3v(insectCount, vector<double>(numPatch));
-    vector<vector<double>> k4v(insectCount, vector<double>(numPatch));
+    vector<vector<T>> k1v(insectCount, vector<T>(numPatch));
+    vector<vector<T>> k2v(insectCount, vector<T>(numPatch));
+    vector<vector<T>> k3v(insectCount, vector<T>(numPatch));
+    vector<vector<T>> k4v(insectCount, vector<T>(numPatch));
     
-    vector<vector<double>> k1p(plantCount, vector<double>(numPatch));
-    vector<vector<double>> k2p(plantCount, vector<double>(numPatch));
-    vector<vector<double>> k3p(plantCount, vector<double>(numPatch));
-    vector<vector<double>> k4p(plantCount, vector<double>(numPatch)); 
+    vector<vector<T>> k1p(plantCount, vector<T>(numPatch));
+    vector<vector<T>> k2p(plantCount, vector<T>(numPatch));
+    vector<vector<T>> k3p(plantCount, vector<T>(numPatch));
+    vector<vector<T>> k4p(plantCount, vector<T>(numPatch)); 
     
-    vector<vector<double>> fv(insectCount, vector<double>(numPatch));
-    vector<vector<double>> fp(plantCount, vector<double>(numPatch));
+    vector<vector<T>> fv(insectCount, vector<T>(numPatch));
+    vector<vector<T>> fp(plantCount, vector<T>(numPatch));
     
-    vector<vector<double>> auxp(plantCount, vector<double>(numPatch));
-    vector<vector<double>> auxv(insectCount, vector<double>(numPatch));
+    vector<vector<T>> auxp(plantCount, vector<T>(numPatch));
+    vector<vector<T>> auxv(insectCount, vector<T>(numPatch));
     
     //k1p k1v
     for(int i=0 ; i<plantCount ; i++)
@@ -84,7 +137,7 @@ void rungekutta(vector<vector<double>>& p, vector<vector<double>>& v, const vect
         for(int site=0 ; site<numPatch ; site++)
         {
             k1p[i][site] = 0.0;
-            evaluaFp(p[i][site],v,fp[i][site],gamma,i,site,insectCount);
+            evaluaFpKernel<T, LINEAR, UNIT_ALPHA>(p[i][site],v,fp[i][site],gamma,par,i,site,insectCount);
             k1p[i][site] = h*fp[i][site];
         }
     }
@@ -93,7 +146,7 @@ void rungekutta(vector<vector<double>>& p, vector<vector<double>>& v, const vect
         for(int site=0 ; site<numPatch ; site++)
         {
             k1v[i][site] = 0.0;
-            evaluaFv(p,v,fv[i][site],gamma,i,site,plantCount,numPatch,D);
+            evaluaFvKernel<T, LINEAR, UNIT_ALPHA>(p,v,fv[i][site],gamma,par,i,site,plantCount,numPatch,D);
             k1v[i][site] = h*fv[i][site];
         }
     }
@@ -121,7 +174,7 @@ void rungekutta(vector<vector<double>>& p, vector<vector<double>>& v, const vect
         for(int site=0 ; site<numPatch ; site++)
         {
             k2p[i][site] = 0.0;
-            evaluaFp(auxp[i][site],auxv,fp[i][site],gamma,i,site,insectCount);
+            evaluaFpKernel<T, LINEAR, UNIT_ALPHA>(auxp[i][site],auxv,fp[i][site],gamma,par,i,site,insectCount);
             k2p[i][site] = h*fp[i][site];
         }
     }
@@ -131,7 +184,7 @@ void rungekutta(vector<vector<double>>& p, vector<vector<double>>& v, const vect
         for(int site=0 ; site<numPatch ; site++)
         {
             k2v[i][site] = 0.0;
-            evaluaFv(auxp,auxv,fv[i][site],gamma,i,site,plantCount,numPatch,D);
+            evaluaFvKernel<T, LINEAR, UNIT_ALPHA>(auxp,auxv,fv[i][site],gamma,par,i,site,plantCount,numPatch,D);
             k2v[i][site] = h*fv[i][site];
         }
     }
@@ -159,7 +212,7 @@ void rungekutta(vector<vector<double>>& p, vector<vector<double>>& v, const vect
         for(int site=0 ; site<numPatch ; site++)
         {
             k3p[i][site] = 0.0;
-            evaluaFp(auxp[i][site],auxv,fp[i][site],gamma,i,site,insectCount);
+            evaluaFpKernel<T, LINEAR, UNIT_ALPHA>(auxp[i][site],auxv,fp[i][site],gamma,par,i,site,insectCount);
             k3p[i][site] = h*fp[i][site];
         }
     }
@@ -169,7 +222,7 @@ void rungekutta(vector<vector<double>>& p, vector<vector<double>>& v, const vect
         for(int site=0 ; site<numPatch ; site++)
         {
             k3v[i][site] = 0.0;
-            evaluaFv(auxp,auxv,fv[i][site],gamma,i,site,plantCount,numPatch,D);
+            evaluaFvKernel<T, LINEAR, UNIT_ALPHA>(auxp,auxv,fv[i][site],gamma,par,i,site,plantCount,numPatch,D);
             k3v[i][site] = h*fv[i][site];
         }
     }
@@ -196,11 +249,14 @@ void rungekutta(vector<vector<double>>& p, vector<vector<double>>& v, const vect
         for(int site=0 ; site<numPatch ; site++)
         {
             k4p[i][site] = 0.0;
-            evaluaFp(auxp[i][site],auxv,fp[i][site],gamma,i,site,insectCount);
+            evaluaFpKernel<T, LINEAR, UNIT_ALPHA>(auxp[i][site],auxv,fp[i][site],gamma,par,i,site,insectCount);
             k4p[i][site] = h*fp[i][site];
             sumap=0.0;
-            sumap=k1p[i][site]+(2*k2p[i][site])+(2*k3p[i][site])+k4p[i][site];
+            sumap=(double)k1p[i][site]+(2.0*k2p[i][site])+(2.0*k3p[i][site])+k4p[i][site];
+            T prev = p[i][site];
             p[i][site]+=(sumap/6.0);
+            if(p[i][site] != prev && abs(sumap/6.0) > max_delta)
+                max_delta = abs(sumap/6.0);
         }
     }
     
@@ -209,17 +265,376 @@ void rungekutta(vector<vector<double>>& p, vector<vector<double>>& v, const vect
         for(int site=0 ; site<numPatch ; site++)
         {
             k4v[i][site] = 0.0;
-            evaluaFv(auxp,auxv,fv[i][site],gamma,i,site,plantCount,numPatch,D);
+            evaluaFvKernel<T, LINEAR, UNIT_ALPHA>(auxp,auxv,fv[i][site],gamma,par,i,site,plantCount,numPatch,D);
             k4v[i][site] = h*fv[i][site];
             sumav=0.0;
-            sumav=k1v[i][site]+(2*k2v[i][site])+(2*k3v[i][site])+k4v[i][site];
+            sumav=(double)k1v[i][site]+(2.0*k2v[i][site])+(2.0*k3v[i][site])+k4v[i][site];
+            T prev = v[i][site];
             v[i][site]+=(sumav/6.0);
+            if(v[i][site] != prev && abs(sumav/6.0) > max_delta)
+                max_delta = abs(sumav/6.0);
         }
     }
+    return max_delta;
+}
+
+template<typename T>
+double rungekuttaStep(vector<vector<T>>& p, vector<vector<T>>& v, const vector<vector<vector<T>>>& gamma, const Params& par, double h, int plantCount, int insectCount, int numPatch, double D)
+{
+    bool linear = (par.ha == 0.0);
+    bool unitAlpha = (par.alpha == 1.0);
+    
+    if (linear && unitAlpha)
+        return rungekuttaKernel<T, true, true>(p, v, gamma, par, h, plantCount, insectCount, numPatch, D);
+    else if (linear)
+        return rungekuttaKernel<T, true, false>(p, v, gamma, par, h, plantCount, insectCount, numPatch, D);
+    else if (unitAlpha)
+        return rungekuttaKernel<T, false, true>(p, v, gamma, par, h, plantCount, insectCount, numPatch, D);
+    else
+        return rungekuttaKernel<T, false, false>(p, v, gamma, par, h, plantCount, insectCount, numPatch, D);
+}
+
+template<typename T>
+void rungekutta(vector<vector<T>>& p, vector<vector<T>>& v, const vector<vector<vector<T>>>& gamma, const Params& par, double h, int plantCount, int insectCount, int numPatch, double D)
+{
+    rungekuttaStep(p, v, gamma, par, h, plantCount, insectCount, numPatch, D);
     return;
 }
 
-void findSteadyState(double t, vector<vector<double>>& p, vector<vector<double>>& v, ofstream& fichp, ofstream& fichv, int plantCount, int insectCount, int numPatch,  const vector<vector<vector<double>>>& gamma, double h, double D)
+//Intra-step parallelism for single large networks (setIntegratorThreads). Each worker owns a block of
+//plant rows and a block of insect rows and runs every RK4 stage on them, with a barrier between stages.
+//Every value is computed by the same expression as in rungekuttaKernel, so the result is bitwise the
+//same as the serial step whatever the number of threads.
+
+//Persistent workers: run(task) calls task(worker) on every worker, the caller being worker 0
+struct StagePool
+{
+    vector<thread> workers;
+    
+    mutex lock;
+    condition_variable wake, finished;
+    const function<void(int)>* task = nullptr;
+    long generation = 0;
+    int running = 0;
+    bool stop = false;
+    
+    mutex phaseLock;
+    condition_variable phaseDone;
+    int arrived = 0;
+    long phase = 0;
+    
+    //Held by the integration using the pool; any other one running meanwhile stays serial
+    mutex busy;
+    
+    int size() const
+    {
+        return workers.size() + 1;
+    }
+    
+    void loop(int worker, long seen)
+    {
+        while (true)
+        {
+            const function<void(int)>* current;
+            {
+                unique_lock<mutex> guard(lock);
+                wake.wait(guard, [&]{ return stop || generation != seen; });
+                if (stop)
+                    return;
+                seen = generation;
+                current = task;
+            }
+            
+            (*current)(worker);
+            
+            lock_guard<mutex> guard(lock);
+            if (--running == 0)
+                finished.notify_one();
+        }
+    }
+    
+    void run(const function<void(int)>& f)
+    {
+        {
+            lock_guard<mutex> guard(lock);
+            task = &f;
+            running = workers.size();
+            generation++;
+        }
+        wake.notify_all();
+        
+        f(0);
+        
+        unique_lock<mutex> guard(lock);
+        finished.wait(guard, [&]{ return running == 0; });
+    }
+    
+    void barrier()
+    {
+        unique_lock<mutex> guard(phaseLock);
+        long current = phase;
+        if (++arrived == size())
+        {
+            arrived = 0;
+            phase++;
+            phaseDone.notify_all();
+        }
+        else
+            phaseDone.wait(guard, [&]{ return phase != current; });
+    }
+    
+    void stopWorkers()
+    {
+        {
+            lock_guard<mutex> guard(lock);
+            stop = true;
+        }
+        wake.notify_all();
+        for (auto& worker : workers)
+            worker.join();
+        workers.clear();
+        stop = false;
+    }
+    
+    void resize(int numThreads)
+    {
+        stopWorkers();
+        for (int w=1 ; w<numThreads ; w++)
+            workers.emplace_back(&StagePool::loop, this, w, generation);
+    }
+    
+    ~StagePool()
+    {
+        stopWorkers();
+    }
+};
+
+StagePool stagePool;
+
+void setIntegratorThreads(int numThreads)
+{
+    lock_guard<mutex> guard(stagePool.busy);
+    stagePool.resize(max(1, numThreads));
+}
+
+int integratorThreads()
+{
+    return stagePool.size();
+}
+
+//First row of a worker's block
+inline int blockStart(int count, int worker, int numThreads)
+{
+    return (long long)count*worker/numThreads;
+}
+
+//RK4 stages kept between steps. Rows are allocated by the worker that owns them, so on NUMA machines
+//they are placed on that worker's node (first touch).
+template<typename T>
+struct StageWorkspace
+{
+    int plantCount = -1, insectCount = -1, numPatch = -1, numThreads = 0;
+    
+    vector<vector<T>> k1p, k2p, k3p, k4p, k1v, k2v, k3v, k4v;
+    
+    //Stage inputs, alternated so that a stage can write the next input while others read its own
+    vector<vector<T>> auxp[2], auxv[2];
+    
+    //Largest increment of each worker's block in the last step, among the cells it changed
+    vector<double> maxDelta;
+    
+    //Copy of the state integrated on the pool, so that the rows each worker updates are on its node too
+    vector<vector<T>> p, v;
+};
+
+template<typename T>
+StageWorkspace<T>& stageWorkspace(int plantCount, int insectCount, int numPatch)
+{
+    static StageWorkspace<T> ws;
+    int numThreads = stagePool.size();
+    
+    if (ws.plantCount == plantCount && ws.insectCount == insectCount && ws.numPatch == numPatch && ws.numThreads == numThreads)
+        return ws;
+    
+    ws.plantCount = plantCount;
+    ws.insectCount = insectCount;
+    ws.numPatch = numPatch;
+    ws.numThreads = numThreads;
+    ws.maxDelta.assign(numThreads, 0.0);
+    
+    vector<vector<vector<T>>*> plantRows = {&ws.k1p, &ws.k2p, &ws.k3p, &ws.k4p, &ws.auxp[0], &ws.auxp[1], &ws.p};
+    vector<vector<vector<T>>*> insectRows = {&ws.k1v, &ws.k2v, &ws.k3v, &ws.k4v, &ws.auxv[0], &ws.auxv[1], &ws.v};
+    
+    for (auto rows : plantRows)
+        rows->assign(plantCount, vector<T>());
+    for (auto rows : insectRows)
+        rows->assign(insectCount, vector<T>());
+    
+    function<void(int)> allocate = [&](int w)
+    {
+        for (auto rows : plantRows)
+            for (int i=blockStart(plantCount, w, numThreads) ; i<blockStart(plantCount, w+1, numThreads) ; i++)
+                (*rows)[i].assign(numPatch, 0.0);
+        for (auto rows : insectRows)
+            for (int i=blockStart(insectCount, w, numThreads) ; i<blockStart(insectCount, w+1, numThreads) ; i++)
+                (*rows)[i].assign(numPatch, 0.0);
+    };
+    stagePool.run(allocate);
+    
+    return ws;
+}
+
+//Copies the state into the workspace rows or back, each worker its own block. Assigning rows of the
+//same size keeps their storage, so the rows stay where their worker placed them
+template<typename T>
+void exchangeState(StageWorkspace<T>& ws, vector<vector<T>>& p, vector<vector<T>>& v, bool toWorkspace)
+{
+    function<void(int)> copy = [&](int w)
+    {
+        for (int i=blockStart(ws.plantCount, w, ws.numThreads) ; i<blockStart(ws.plantCount, w+1, ws.numThreads) ; i++)
+        {
+            if (toWorkspace)
+                ws.p[i] = p[i];
+            else
+                p[i] = ws.p[i];
+        }
+        for (int i=blockStart(ws.insectCount, w, ws.numThreads) ; i<blockStart(ws.insectCount, w+1, ws.numThreads) ; i++)
+        {
+            if (toWorkspace)
+                ws.v[i] = v[i];
+            else
+                v[i] = ws.v[i];
+        }
+    };
+    stagePool.run(copy);
+}
+
+template<typename T, bool LINEAR, bool UNIT_ALPHA>
+void rungekuttaBlock(StageWorkspace<T>& ws, vector<vector<T>>& p, vector<vector<T>>& v, const vector<vector<vector<T>>>& gamma, const Params& par, double h, int plantCount, int insectCount, int numPatch, double D, int worker)
+{
+    int numThreads = ws.numThreads;
+    int p0 = blockStart(plantCount, worker, numThreads), p1 = blockStart(plantCount, worker+1, numThreads);
+    int v0 = blockStart(insectCount, worker, numThreads), v1 = blockStart(insectCount, worker+1, numThreads);
+    
+    vector<vector<T>>& auxpA = ws.auxp[0];
+    vector<vector<T>>& auxvA = ws.auxv[0];
+    vector<vector<T>>& auxpB = ws.auxp[1];
+    vector<vector<T>>& auxvB = ws.auxv[1];
+    T f;
+    
+    //k1p k1v, and the input of k2
+    for(int i=p0 ; i<p1 ; i++)
+        for(int site=0 ; site<numPatch ; site++)
+        {
+            evaluaFpKernel<T, LINEAR, UNIT_ALPHA>(p[i][site],v,f,gamma,par,i,site,insectCount);
+            ws.k1p[i][site] = h*f;
+            auxpA[i][site] = p[i][site]+(0.5*ws.k1p[i][site]);
+        }
+    for(int i=v0 ; i<v1 ; i++)
+        for(int site=0 ; site<numPatch ; site++)
+        {
+            evaluaFvKernel<T, LINEAR, UNIT_ALPHA>(p,v,f,gamma,par,i,site,plantCount,numPatch,D);
+            ws.k1v[i][site] = h*f;
+            auxvA[i][site] = v[i][site]+(0.5*ws.k1v[i][site]);
+        }
+    stagePool.barrier();
+    
+    //k2p k2v, and the input of k3
+    for(int i=p0 ; i<p1 ; i++)
+        for(int site=0 ; site<numPatch ; site++)
+        {
+            evaluaFpKernel<T, LINEAR, UNIT_ALPHA>(auxpA[i][site],auxvA,f,gamma,par,i,site,insectCount);
+            ws.k2p[i][site] = h*f;
+            auxpB[i][site] = p[i][site]+(0.5*ws.k2p[i][site]);
+        }
+    for(int i=v0 ; i<v1 ; i++)
+        for(int site=0 ; site<numPatch ; site++)
+        {
+            evaluaFvKernel<T, LINEAR, UNIT_ALPHA>(auxpA,auxvA,f,gamma,par,i,site,plantCount,numPatch,D);
+            ws.k2v[i][site] = h*f;
+            auxvB[i][site] = v[i][site]+(0.5*ws.k2v[i][site]);
+        }
+    stagePool.barrier();
+    
+    //k3p k3v, and the input of k4
+    for(int i=p0 ; i<p1 ; i++)
+        for(int site=0 ; site<numPatch ; site++)
+        {
+            evaluaFpKernel<T, LINEAR, UNIT_ALPHA>(auxpB[i][site],auxvB,f,gamma,par,i,site,insectCount);
+            ws.k3p[i][site] = h*f;
+            auxpA[i][site] = p[i][site] + ws.k3p[i][site];
+        }
+    for(int i=v0 ; i<v1 ; i++)
+        for(int site=0 ; site<numPatch ; site++)
+        {
+            evaluaFvKernel<T, LINEAR, UNIT_ALPHA>(auxpB,auxvB,f,gamma,par,i,site,plantCount,numPatch,D);
+            ws.k3v[i][site] = h*f;
+            auxvA[i][site] = v[i][site] + ws.k3v[i][site];
+        }
+    stagePool.barrier();
+    
+    //k4p k4v and the update; nobody reads p or v in this stage
+    double max_delta = 0.0;
+    for(int i=p0 ; i<p1 ; i++)
+        for(int site=0 ; site<numPatch ; site++)
+        {
+            evaluaFpKernel<T, LINEAR, UNIT_ALPHA>(auxpA[i][site],auxvA,f,gamma,par,i,site,insectCount);
+            ws.k4p[i][site] = h*f;
+            double sumap=(double)ws.k1p[i][site]+(2.0*ws.k2p[i][site])+(2.0*ws.k3p[i][site])+ws.k4p[i][site];
+            T prev = p[i][site];
+            p[i][site]+=(sumap/6.0);
+            double delta = (p[i][site] != prev) ? abs(sumap/6.0) : 0.0;
+            if(delta > max_delta)
+                max_delta = delta;
+        }
+    for(int i=v0 ; i<v1 ; i++)
+        for(int site=0 ; site<numPatch ; site++)
+        {
+            evaluaFvKernel<T, LINEAR, UNIT_ALPHA>(auxpA,auxvA,f,gamma,par,i,site,plantCount,numPatch,D);
+            ws.k4v[i][site] = h*f;
+            double sumav=(double)ws.k1v[i][site]+(2.0*ws.k2v[i][site])+(2.0*ws.k3v[i][site])+ws.k4v[i][site];
+            T prev = v[i][site];
+            v[i][site]+=(sumav/6.0);
+            double delta = (v[i][site] != prev) ? abs(sumav/6.0) : 0.0;
+            if(delta > max_delta)
+                max_delta = delta;
+        }
+    ws.maxDelta[worker] = max_delta;
+}
+
+//One step on the pool (whose busy lock the caller holds); returns the largest increment of the state
+template<typename T>
+double rungekuttaParallel(vector<vector<T>>& p, vector<vector<T>>& v, const vector<vector<vector<T>>>& gamma, const Params& par, double h, int plantCount, int insectCount, int numPatch, double D)
+{
+    StageWorkspace<T>& ws = stageWorkspace<T>(plantCount, insectCount, numPatch);
+    
+    bool linear = (par.ha == 0.0);
+    bool unitAlpha = (par.alpha == 1.0);
+    
+    function<void(int)> step = [&](int w)
+    {
+        if (linear && unitAlpha)
+            rungekuttaBlock<T, true, true>(ws, p, v, gamma, par, h, plantCount, insectCount, numPatch, D, w);
+        else if (linear)
+            rungekuttaBlock<T, true, false>(ws, p, v, gamma, par, h, plantCount, insectCount, numPatch, D, w);
+        else if (unitAlpha)
+            rungekuttaBlock<T, false, true>(ws, p, v, gamma, par, h, plantCount, insectCount, numPatch, D, w);
+        else
+            rungekuttaBlock<T, false, false>(ws, p, v, gamma, par, h, plantCount, insectCount, numPatch, D, w);
+    };
+    stagePool.run(step);
+    
+    //Fixed order, so the reduction does not depend on which worker finished first
+    double max_delta = 0.0;
+    for (double delta : ws.maxDelta)
+        if (delta > max_delta)
+            max_delta = delta;
+    
+    return max_delta;
+}
+
+template<typename T>
+void findSteadyState(double t, vector<vector<T>>& p, vector<vector<T>>& v, ofstream& fichp, ofstream& fichv, int plantCount, int insectCount, int numPatch,  const vector<vector<vector<T>>>& gamma, const Params& par, double h, double D, ostream& log)
 {
     //Stationary state detection
     double max_delta = 1.0;
@@ -227,8 +642,16 @@ void findSteadyState(double t, vector<vector<double>>& p, vector<vector<double>>
     int iter_count = 0;
     int max_iter = 1000000;
     
-    vector<vector<double>> p_prev(plantCount, vector<double>(numPatch));
-    vector<vector<double>> v_prev(insectCount, vector<double>(numPatch));
+    //With integrator threads the step and the max_delta reduction run on the pool
+    unique_lock<mutex> pool(stagePool.busy, try_to_lock);
+    bool parallel = pool.owns_lock() && stagePool.size() > 1;
+    
+    //On the pool the state is integrated in the workspace, whose rows are placed by their workers
+    StageWorkspace<T>* ws = parallel ? &stageWorkspace<T>(plantCount, insectCount, numPatch) : nullptr;
+    if (ws)
+        exchangeState(*ws, p, v, true);
+    vector<vector<T>>& ps = ws ? ws->p : p;
+    vector<vector<T>>& vs = ws ? ws->v : v;
     
     while(iter_count < max_iter)
     {   
@@ -237,52 +660,34 @@ void findSteadyState(double t, vector<vector<double>>& p, vector<vector<double>>
         
         for(int i=0 ; i<plantCount ; i++)
             for(int site=0 ; site<numPatch ; site++)
-                fichp << p[i][site] << " ";
+                fichp << ps[i][site] << " ";
         
         for(int i=0 ; i<insectCount ; i++)
             for(int site=0 ; site<numPatch ; site++)
-                fichv << v[i][site] << " ";
+                fichv << vs[i][site] << " ";
 
         fichp << endl;
         fichv << endl;
 
-        p_prev = p;
-        v_prev = v;
-
-        rungekutta(p,v,gamma,h,plantCount,insectCount,numPatch,D); 
+        if (parallel)
+            max_delta = rungekuttaParallel(ps,vs,gamma,par,h,plantCount,insectCount,numPatch,D);
+        else
+            max_delta = rungekuttaStep(ps,vs,gamma,par,h,plantCount,insectCount,numPatch,D);
         t+=h;   
         iter_count++;
         
-        max_delta = 0.0;
-        for(int i=0 ; i<plantCount ; i++)
-        {
-            for(int site=0 ; site<numPatch ; site++)
-            {
-                double delta = abs(p[i][site] - p_prev[i][site]);
-                if(delta > max_delta)
-                    max_delta = delta;
-            }
-        }
-        
-        for(int i=0 ; i<insectCount ; i++)
-        {
-            for(int site=0 ; site<numPatch ; site++)
-            {
-                double delta = abs(v[i][site] - v_prev[i][site]);
-                if(delta > max_delta)
-                    max_delta = delta;
-            }
-        }
-        
         if (max_delta < TOLERANCE && iter_count > 1000) 
         {
-            cout << "Stationary state at t = " << t << " (iter " << iter_count << ")" << endl;
+            log << "Stationary state at t = " << t << " (iter " << iter_count << ")" << endl;
             break;
         }
     }
     
     if (iter_count == max_iter)
-        cout << "  No convergence." << endl;
+        log << "  No convergence." << endl;
+    
+    if (ws)
+        exchangeState(*ws, p, v, false);
     
     fichp << t << " ";
     fichv << t << " ";
@@ -298,7 +703,91 @@ void findSteadyState(double t, vector<vector<double>>& p, vector<vector<double>>
     return;
 }
 
-void loadGamma(const string &filename, map<string, int>& plantIndex, map<string, int>& insectIndex, int& plantCount, int& insectCount, int& numPatch, vector<vector<vector<double>>>& gamma)
+bool setParam(Params& par, const string& key, double value)
+{
+    if (key == "m") par.m = value;
+    else if (key == "r") par.r = value;
+    else if (key == "Kp") par.Kp = value;
+    else if (key == "Kv") par.Kv = value;
+    else if (key == "ha") par.ha = value;
+    else if (key == "d") par.d = value;
+    else if (key == "alpha") par.alpha = value;
+    else return false;
+    
+    return true;
+}
+
+bool parseParam(const string& token, Params& par)
+{
+    size_t eq = token.find('=');
+    if (eq == string::npos)
+        return false;
+    
+    istringstream iss(token.substr(eq + 1));
+    double value;
+    if (!(iss >> value))
+        return false;
+    
+    return setParam(par, token.substr(0, eq), value);
+}
+
+bool loadParams(const string& filename, Params& par)
+{
+    ifstream parfich(filename);
+    if (!parfich)
+        return false;
+    
+    string line, key;
+    double value;
+    
+    while (getline(parfich, line))
+    {
+        if (line.empty() || line[0] == '#')
+            continue;
+        
+        replace(line.begin(), line.end(), '=', ' ');
+        istringstream iss(line);
+        if (!(iss >> key))
+            continue;
+        if (!(iss >> value) || !setParam(par, key, value))
+        {
+            cerr << "Bad parameter line in " << filename << ": " << line << endl;
+            return false;
+        }
+    }
+    
+    return true;
+}
+
+bool readParams(int argc, char** argv, Params& par)
+{
+    for (int i=1 ; i<argc ; i++)
+    {
+        string arg = argv[i];
+        if (arg.compare(0, 8, "threads=") == 0)
+        {
+            setIntegratorThreads(atoi(arg.c_str() + 8));
+            continue;
+        }
+        
+        bool ok = (arg.find('=') != string::npos) ? parseParam(arg, par) : loadParams(arg, par);
+        if (!ok)
+        {
+            cerr << "Cannot read parameters from " << arg << endl;
+            return false;
+        }
+    }
+    
+    return true;
+}
+
+void printParams(const Params& par)
+{
+    cout << "m = " << par.m << ", r = " << par.r << ", Kp = " << par.Kp << ", Kv = " << par.Kv << ", ha = " << par.ha << ", d = " << par.d << ", alpha = " << par.alpha << endl;
+}
+
+template<typename T>
+void loadGamma(const string &filename, map<string, int>& plantIndex, map<string, int>& insectIndex, int& plantCount, int& insectCount, int& numPatch, vector<vector<vector<T>>>& gamma, ostream& log)
 {
     ifstream intfich(filename);
 
@@ -328,9 +817,9 @@ void loadGamma(const string &filename, map<string, int>& plantIndex, map<string,
     
     intfich.close();
     
-    cout << endl << numPatch << " patches." << endl << endl;
+    log << endl << numPatch << " patches." << endl << endl;
     
-    gamma.resize(numPatch, vector<vector<double>>(plantCount, vector<double>(insectCount, 0.0)));
+    gamma.resize(numPatch, vector<vector<T>>(plantCount, vector<T>(insectCount, 0.0)));
     
     for (const auto& item : data) 
     {
@@ -347,41 +836,42 @@ void loadGamma(const string &filename, map<string, int>& plantIndex, map<string,
     return;
 }
 
-void runExtinctionExperiment(const vector<vector<double>>& p, const vector<vector<double>>& v, const vector<vector<vector<double>>>& gamma, double h, int plantCount, int insectCount, int numPatch, double D)
+vector<string> speciesNames(const map<string, int>& plantIndex, const map<string, int>& insectIndex, int plantCount, int insectCount)
 {
-    cout << "\n---Initializing extinction experiment ---" << endl;
+    vector<string> names(plantCount + insectCount);
     
-    //Plant ranking
-    vector<pair<double, int>> plantRanking;
+    for (const auto& item : plantIndex)
+        names[item.second] = item.first;
+    for (const auto& item : insectIndex)
+        names[plantCount + item.second] = item.first;
+    
+    return names;
+}
+
+template<typename T>
+void initializeState(vector<vector<T>>& p, vector<vector<T>>& v, const vector<vector<vector<T>>>& gamma, int plantCount, int insectCount, int numPatch)
+{
+    p.assign(plantCount, vector<T>(numPatch, 0.0));
+    v.assign(insectCount, vector<T>(numPatch, 0.0));
     
     for(int i=0 ; i<plantCount ; i++)
-    {
-        double abundance = 0.0;
         for(int site=0 ; site<numPatch ; site++)
-        {
-            abundance += p[i][site];
-        }
-        plantRanking.push_back({abundance,i});
-    }
-    
-    sort(plantRanking.begin(), plantRanking.end());
+            if (plantExistsInPatch(i, site, insectCount, gamma))
+                p[i][site] = 100.0;
     
+    for(int i=0 ; i<insectCount ; i++)
+        for(int site=0 ; site<numPatch ; site++)
+            if (insectExistsInPatch(i, site, plantCount, gamma))
+                v[i][site] = 500.0;
     
-    //Preparation
-    ofstream experimentFile("results.txt");
-    
-    experimentFile << "# Num_Extinctions Robustness_Ratio Surv_Plants Surv_Insects Pollination_Service Gini_Plants Gini_Insects" << endl;
-    
-    ofstream dummy_p("/dev/null");
-    ofstream dummy_v("/dev/null");
-    
-    vector<vector<double>> pCurrent = p;
-    vector<vector<double>> vCurrent = v;
-    
-    double tDummy = 0.0;
-    
-    int initialSurvPlants = 0;
-    int initialSurvInsects = 0;
+    return;
+}
+
+template<typename T>
+void countSurvivors(const vector<vector<T>>& p, const vector<vector<T>>& v, int plantCount, int insectCount, int numPatch, int& survPlants, int& survInsects)
+{
+    survPlants = 0;
+    survInsects = 0;
     
     for(int i=0; i<plantCount; ++i) 
     {
@@ -389,7 +879,7 @@ void runExtinctionExperiment(const vector<vector<double>>& p, const vector<vecto
         for(int s=0; s<numPatch; ++s) 
             total += p[i][s];
         if(total > viability) 
-            initialSurvPlants++;
+            survPlants++;
     }
     
     for(int i=0; i<insectCount; ++i) 
@@ -398,287 +888,317 @@ void runExtinctionExperiment(const vector<vector<double>>& p, const vector<vecto
         for(int s=0; s<numPatch; ++s) 
             total += v[i][s];
         if(total > viability) 
-            initialSurvInsects++;
+            survInsects++;
     }
     
-    int totalInitialSpecies = initialSurvPlants + initialSurvInsects;
-    
-    cout << "Especies Iniciales Vivas: " << totalInitialSpecies << " (Plantas: " << initialSurvPlants << ", Insectos: " << initialSurvInsects << ")" << endl;
-    
-    double sumRobustness = 0.0;
-    int kEffective = 0, steps = 0;
+    return;
+}
+
+template<typename T>
+ExtinctionStep measureStep(int numExtinctions, const vector<vector<T>>& p, const vector<vector<T>>& v, int plantCount, int insectCount, int numPatch, int totalInitialSpecies)
+{
+    int survPlants = 0;
+    int survInsects = 0;
+    double plantBiomass = 0.0, insectBiomass = 0.0;
+    double sum2p = 0.0, sum2v = 0.0;
     
-    //Experiment
-    for(int k=0; k<=plantCount ; k++)
+    for (int i=0 ; i<plantCount ; i++)
     {
-        if (k>0)
-        {
-            int plantToRemove = plantRanking[k-1].second;
-            double currentAbundance = 0.0;
-            for(int site=0 ; site<numPatch ; site++)
-                currentAbundance += pCurrent[plantToRemove][site];
-            
-            if (currentAbundance <= viability)
-                continue;
-                
-            for(int site=0 ; site<numPatch ; site++)
-                pCurrent[plantToRemove][site] = 0.0;
-            kEffective++;
-            
-            findSteadyState(tDummy, pCurrent, vCurrent, dummy_p, dummy_v, plantCount, insectCount, numPatch, gamma, h,D);
-        }
-        
-        //Metrics
-        int survPlants = 0;
-        int survInsects = 0;
-        double plantBiomass = 0.0, insectBiomass = 0.0;
-        double sum2p = 0.0, sum2v = 0.0;
+        double total = 0.0;
+        for(int site=0 ; site<numPatch ; site++)
+            total += p[i][site];
         
-        for (int i=0 ; i<plantCount ; i++)
+        if(total > viability) 
+        {
+            survPlants++;
+            plantBiomass += total;
+        }            
+    }
+    
+    if (plantBiomass > 0)
+    {
+        for(int i=0 ; i<plantCount ; i++)
         {
             double total = 0.0;
             for(int site=0 ; site<numPatch ; site++)
-                total += pCurrent[i][site];
-            
-            if(total > viability) 
+                total += p[i][site];
+            if(total > viability)
             {
-                survPlants++;
-                plantBiomass += total;
-            }            
+                double prob = total / plantBiomass;
+                sum2p += (prob * prob);
+            }
         }
+    }
+    
+    for (int i=0 ; i<insectCount ; i++)
+    {
+        double total = 0.0;
+        for(int site=0 ; site<numPatch ; site++)
+            total += v[i][site];
         
-        if (plantBiomass > 0)
+        if(total > viability) 
+        {
+            survInsects++;
+            insectBiomass += total;  
+        }          
+    }
+    
+    if (insectBiomass > 0)
+    {
+        for(int i=0 ; i<insectCount ; i++)
         {
-            for(int i=0 ; i<plantCount ; i++)
+            double total = 0.0;
+            for(int site=0 ; site<numPatch ; site++)
+                total += v[i][site];
+            if(total > viability)
             {
-                double total = 0.0;
-                for(int site=0 ; site<numPatch ; site++)
-                    total += pCurrent[i][site];
-                if(total > viability)
-                {
-                    double prob = total / plantBiomass;
-                    sum2p += (prob * prob);
-                }
+                double prob = total / insectBiomass;
+                sum2v += (prob * prob);
             }
         }
+    }
+    
+    ExtinctionStep step;
+    step.numExtinctions = numExtinctions;
+    step.robustness = (double)(survPlants + survInsects) / (1.0*totalInitialSpecies);
+    step.survPlants = survPlants;
+    step.survInsects = survInsects;
+    step.pollinationService = insectBiomass;
+    step.giniP = 1.0 - sum2p;
+    step.giniV = 1.0 - sum2v;
+    
+    return step;
+}
+
+template<typename T>
+int cascadeExtinctions(vector<vector<T>>& p, vector<vector<T>>& v, const vector<vector<vector<T>>>& gamma, const Params& par, int plantCount, int insectCount, int numPatch, double D)
+{
+    //Without partners the gain is 0: insects decay at least at rate d (dispersal only moves them between
+    //patches) and plants at rate m, so with positive losses they go extinct. Only exact zeros count as
+    //lost partners, as they are the only values the integrator keeps forever.
+    int removed = 0;
+    bool changed = true;
+    
+    vector<bool> insectGone(insectCount);
+    
+    while (changed)
+    {
+        changed = false;
         
-        for (int i=0 ; i<insectCount ; i++)
+        //Insects: every partner plant is 0 in every patch
+        for(int i=0 ; i<insectCount ; i++)
         {
-            double total = 0.0;
+            bool alive = false, supported = false;
             for(int site=0 ; site<numPatch ; site++)
-                total += vCurrent[i][site];
+            {
+                if (v[i][site] != 0.0)
+                    alive = true;
+                for(int j=0 ; j<plantCount && !supported ; j++)
+                    if (gamma[site][j][i] > 0.0 && p[j][site] != 0.0)
+                        supported = true;
+            }
             
-            if(total > viability) 
+            insectGone[i] = !alive;
+            if (alive && !supported && par.d > 0.0)
             {
-                survInsects++;
-                insectBiomass += total;  
-            }          
+                for(int site=0 ; site<numPatch ; site++)
+                    v[i][site] = 0.0;
+                insectGone[i] = true;
+                removed++;
+                changed = true;
+            }
         }
         
-        if (insectBiomass > 0)
+        //Plants, patch by patch: every partner insect is 0 in that patch and, with dispersal, everywhere
+        if (par.m <= 0.0)
+            break;
+        
+        for(int j=0 ; j<plantCount ; j++)
         {
-            for(int i=0 ; i<insectCount ; i++)
+            bool wasAlive = false, alive = false;
+            for(int site=0 ; site<numPatch ; site++)
             {
-                double total = 0.0;
-                for(int site=0 ; site<numPatch ; site++)
-                    total += vCurrent[i][site];
-                if(total > viability)
+                if (p[j][site] == 0.0)
+                    continue;
+                wasAlive = true;
+                
+                bool supported = false;
+                for(int i=0 ; i<insectCount && !supported ; i++)
+                    if (gamma[site][j][i] > 0.0 && (D > 0.0 ? !insectGone[i] : v[i][site] != 0.0))
+                        supported = true;
+                
+                if (supported)
+                    alive = true;
+                else
                 {
-                    double prob = total / insectBiomass;
-                    sum2v += (prob * prob);
+                    p[j][site] = 0.0;
+                    changed = true;
                 }
             }
+            
+            if (wasAlive && !alive)
+                removed++;
         }
-        
-        double robustness = (double)(survPlants + survInsects) / (1.0*totalInitialSpecies);
-        double pollinationService = insectBiomass;
-        double giniP = 1.0 - sum2p;
-        double giniV = 1.0 - sum2v;
-        
-        sumRobustness += robustness;
-        steps++;
-        experimentFile << kEffective << " " << fixed << setprecision(6) << robustness << " " << survPlants << " " << survInsects << " " << pollinationService << " " << giniP << " " << giniV << endl;
     }
     
-    double Rint = sumRobustness / steps;
-    cout << " R (robustness) = " << Rint << endl;
-    
-    ofstream rFile("robustnessD.txt");
-    rFile << Rint << endl;
-    rFile.close();
-    
-    experimentFile.close();
-    dummy_p.close();
-    dummy_v.close();
-    
-    cout << "---Extinction experiment complete ---" << endl;
-    
-    return;
+    return removed;
 }
 
-void runRandomExtinctionExperiment(const vector<vector<double>>& p, const vector<vector<double>>& v, const vector<vector<vector<double>>>& gamma, double h, int plantCount, int insectCount, int numPatch, double D)
+//Removes the plants in the given order, re-equilibrating after each removal
+template<typename T>
+vector<ExtinctionStep> runRemovalSequence(const vector<int>& order, const vector<vector<T>>& p, const vector<vector<T>>& v, const vector<vector<vector<T>>>& gamma, const Params& par, double h, int plantCount, int insectCount, int numPatch, double D, ostream& log)
 {
-    cout << "\n---Initializing random extinction experiment ---" << endl;
-    
-    //Plant ranking
-    vector<int> plantIndices(plantCount);
-    
-    for(int i=0; i<plantCount ; i++)
-        plantIndices[i] = i;
-    
-    auto rng = default_random_engine(42);
-    shuffle(plantIndices.begin(), plantIndices.end(), rng);
-
-    
-    
-    //Preparation
-    ofstream experimentFile("resultsRandom.txt");
-    
-    experimentFile << "# Num_Extinctions Robustness_Ratio Surv_Plants Surv_Insects Pollination_Service Gini_Plants Gini_Insects" << endl;
-    
     ofstream dummy_p("/dev/null");
     ofstream dummy_v("/dev/null");
     
-    vector<vector<double>> pCurrent = p;
-    vector<vector<double>> vCurrent = v;
+    vector<vector<T>> pCurrent = p;
+    vector<vector<T>> vCurrent = v;
     
     double tDummy = 0.0;
     
     int initialSurvPlants = 0;
     int initialSurvInsects = 0;
     
-    for(int i=0; i<plantCount; ++i) 
-    {
-        double total = 0.0;
-        for(int s=0; s<numPatch; ++s) 
-            total += p[i][s];
-        if(total > viability) 
-            initialSurvPlants++;
-    }
-    
-    for(int i=0; i<insectCount; ++i) 
-    {
-        double total = 0.0;
-        for(int s=0; s<numPatch; ++s) 
-            total += v[i][s];
-        if(total > viability) 
-            initialSurvInsects++;
-    }
+    countSurvivors(p, v, plantCount, insectCount, numPatch, initialSurvPlants, initialSurvInsects);
     
     int totalInitialSpecies = initialSurvPlants + initialSurvInsects;
     
-    cout << "Especies Iniciales Vivas: " << totalInitialSpecies << " (Plantas: " << initialSurvPlants << ", Insectos: " << initialSurvInsects << ")" << endl;
+    log << "Especies Iniciales Vivas: " << totalInitialSpecies << " (Plantas: " << initialSurvPlants << ", Insectos: " << initialSurvInsects << ")" << endl;
     
-    double sumRobustness = 0.0;
-    int kEffective = 0, steps = 0;
+    vector<ExtinctionStep> curve;
+    int kEffective = 0;
     
     //Experiment
-    for(int k=0; k<=plantCount ; k++)
+    for(int k=0; k<=(int)order.size() ; k++)
     {
         if (k>0)
         {
-            int plantToRemove = plantIndices[k-1];
+            int plantToRemove = order[k-1];
             double currentAbundance = 0.0;
-            
             for(int site=0 ; site<numPatch ; site++)
                 currentAbundance += pCurrent[plantToRemove][site];
             
             if (currentAbundance <= viability)
                 continue;
-                            
+                
             for(int site=0 ; site<numPatch ; site++)
                 pCurrent[plantToRemove][site] = 0.0;
-                
             kEffective++;
             
-            findSteadyState(tDummy, pCurrent, vCurrent, dummy_p, dummy_v, plantCount, insectCount, numPatch, gamma, h, D);
-        }
-        
-        //Metrics
-        int survPlants = 0;
-        int survInsects = 0;
-        double plantBiomass = 0.0, insectBiomass = 0.0;
-        double sum2p = 0.0, sum2v = 0.0;
-        
-        for (int i=0 ; i<plantCount ; i++)
-        {
-            double total = 0.0;
-            for(int site=0 ; site<numPatch ; site++)
-                total += pCurrent[i][site];
-            
-            if(total > viability) 
-            {
-                survPlants++;
-                plantBiomass += total;
-            }            
-        }
-        
-        if (plantBiomass > 0)
-        {
-            for(int i=0 ; i<plantCount ; i++)
-            {
-                double total = 0.0;
-                for(int site=0 ; site<numPatch ; site++)
-                    total += pCurrent[i][site];
-                if(total > viability)
-                {
-                    double prob = total / plantBiomass;
-                    sum2p += (prob * prob);
-                }
-            }
-        }
-        
-        for (int i=0 ; i<insectCount ; i++)
-        {
-            double total = 0.0;
-            for(int site=0 ; site<numPatch ; site++)
-                total += vCurrent[i][site];
+            //Secondary extinctions that need no integration
+            cascadeExtinctions(pCurrent, vCurrent, gamma, par, plantCount, insectCount, numPatch, D);
             
-            if(total > viability) 
-            {
-                survInsects++;
-                insectBiomass += total;  
-            }          
+            findSteadyState(tDummy, pCurrent, vCurrent, dummy_p, dummy_v, plantCount, insectCount, numPatch, gamma, par, h, D, log);
         }
         
-        if (insectBiomass > 0)
+        //Metrics
+        curve.push_back(measureStep(kEffective, pCurrent, vCurrent, plantCount, insectCount, numPatch, totalInitialSpecies));
+    }
+    
+    log << " R (robustness) = " << robustnessIndex(curve) << endl;
+    
+    dummy_p.close();
+    dummy_v.close();
+    
+    return curve;
+}
+
+template<typename T>
+vector<ExtinctionStep> runExtinctionExperiment(const vector<vector<T>>& p, const vector<vector<T>>& v, const vector<vector<vector<T>>>& gamma, const Params& par, double h, int plantCount, int insectCount, int numPatch, double D, ostream& log)
+{
+    log << "\n---Initializing extinction experiment ---" << endl;
+    
+    //Plant ranking
+    vector<pair<double, int>> plantRanking;
+    
+    for(int i=0 ; i<plantCount ; i++)
+    {
+        double abundance = 0.0;
+        for(int site=0 ; site<numPatch ; site++)
         {
-            for(int i=0 ; i<insectCount ; i++)
-            {
-                double total = 0.0;
-                for(int site=0 ; site<numPatch ; site++)
-                    total += vCurrent[i][site];
-                if(total > viability)
-                {
-                    double prob = total / insectBiomass;
-                    sum2v += (prob * prob);
-                }
-            }
+            abundance += p[i][site];
         }
-        
-        double robustness = (double)(survPlants + survInsects) / (totalInitialSpecies*1.0);
-        double pollinationService = insectBiomass;
-        double giniP = 1.0 - sum2p;
-        double giniV = 1.0 - sum2v;
-        
-        sumRobustness += robustness;
-        steps++;
-        
-        experimentFile << kEffective << " " << fixed << setprecision(6) << robustness << " " << survPlants << " " << survInsects << " " << pollinationService << " " << giniP << " " << giniV << endl;
+        plantRanking.push_back({abundance,i});
     }
     
-    double Rint = sumRobustness / steps;
-    cout << " R (robustness) = " << Rint << endl;
+    sort(plantRanking.begin(), plantRanking.end());
     
-    ofstream rFile("robustnessD.txt");
-    rFile << Rint << endl;
-    rFile.close();
+    vector<int> order;
+    for (const auto& item : plantRanking)
+        order.push_back(item.second);
+    
+    vector<ExtinctionStep> curve = runRemovalSequence(order, p, v, gamma, par, h, plantCount, insectCount, numPatch, D, log);
+    
+    log << "---Extinction experiment complete ---" << endl;
+    
+    return curve;
+}
+
+template<typename T>
+vector<ExtinctionStep> runRandomExtinctionExperiment(const vector<vector<T>>& p, const vector<vector<T>>& v, const vector<vector<vector<T>>>& gamma, const Params& par, double h, int plantCount, int insectCount, int numPatch, double D, unsigned seed, ostream& log)
+{
+    log << "\n---Initializing random extinction experiment ---" << endl;
+    
+    //Plant ranking
+    vector<int> plantIndices(plantCount);
+    
+    for(int i=0; i<plantCount ; i++)
+        plantIndices[i] = i;
+    
+    auto rng = default_random_engine(seed);
+    shuffle(plantIndices.begin(), plantIndices.end(), rng);
+    
+    vector<ExtinctionStep> curve = runRemovalSequence(plantIndices, p, v, gamma, par, h, plantCount, insectCount, numPatch, D, log);
+    
+    log << "---Extinction experiment complete ---" << endl;
+    
+    return curve;
+}
+
+double robustnessIndex(const vector<ExtinctionStep>& curve)
+{
+    double sumRobustness = 0.0;
+    for (const auto& step : curve)
+        sumRobustness += step.robustness;
+    
+    return sumRobustness / curve.size();
+}
+
+double writeExtinctionResults(const vector<ExtinctionStep>& curve, const string& resultsFile, const string& robustnessFile)
+{
+    ofstream experimentFile(resultsFile);
+    
+    experimentFile << "# Num_Extinctions Robustness_Ratio Surv_Plants Surv_Insects Pollination_Service Gini_Plants Gini_Insects" << endl;
+    
+    for (const auto& step : curve)
+        experimentFile << step.numExtinctions << " " << fixed << setprecision(6) << step.robustness << " " << step.survPlants << " " << step.survInsects << " " << step.pollinationService << " " << step.giniP << " " << step.giniV << endl;
     
     experimentFile.close();
-    dummy_p.close();
-    dummy_v.close();
     
-    cout << "---Extinction experiment complete ---" << endl;
+    double Rint = robustnessIndex(curve);
     
-    return;
+    ofstream rFile(robustnessFile);
+    rFile << Rint << endl;
+    rFile.close();
+    
+    return Rint;
 }
+
+//Explicit instantiations: double is the reference precision, float the reduced-memory mode
+#define INSTANTIATE_MODEL(T) \
+template bool plantExistsInPatch<T>(int, int, int, const vector<vector<vector<T>>>&); \
+template bool insectExistsInPatch<T>(int, int, int, const vector<vector<vector<T>>>&); \
+template void evaluaFp<T>(T, const vector<vector<T>>&, T&, const vector<vector<vector<T>>>&, const Params&, int, int, int); \
+template void evaluaFv<T>(const vector<vector<T>>&, const vector<vector<T>>&, T&, const vector<vector<vector<T>>>&, const Params&, int, int, int, int, double); \
+template void rungekutta<T>(vector<vector<T>>&, vector<vector<T>>&, const vector<vector<vector<T>>>&, const Params&, double, int, int, int, double); \
+template void findSteadyState<T>(double, vector<vector<T>>&, vector<vector<T>>&, ofstream&, ofstream&, int, int, int, const vector<vector<vector<T>>>&, const Params&, double, double, ostream&); \
+template void loadGamma<T>(const string&, map<string, int>&, map<string, int>&, int&, int&, int&, vector<vector<vector<T>>>&, ostream&); \
+template void initializeState<T>(vector<vector<T>>&, vector<vector<T>>&, const vector<vector<vector<T>>>&, int, int, int); \
+template void countSurvivors<T>(const vector<vector<T>>&, const vector<vector<T>>&, int, int, int, int&, int&); \
+template ExtinctionStep measureStep<T>(int, const vector<vector<T>>&, const vector<vector<T>>&, int, int, int, int); \
+template int cascadeExtinctions<T>(vector<vector<T>>&, vector<vector<T>>&, const vector<vector<vector<T>>>&, const Params&, int, int, int, double); \
+template vector<ExtinctionStep> runExtinctionExperiment<T>(const vector<vector<T>>&, const vector<vector<T>>&, const vector<vector<vector<T>>>&, const Params&, double, int, int, int, double, ostream&); \
+template vector<ExtinctionStep> runRandomExtinctionExperiment<T>(const vector<vector<T>>&, const vector<vector<T>>&, const vector<vector<vector<T>>>&, const Params&, double, int, int, int, double, unsigned, ostream&);
+
+INSTANTIATE_MODEL(double)
+INSTANTIATE_MODEL(float)
@@ -15,34 +15,84 @@
 
 using namespace std;
 
-constexpr double m = 0.2;
-constexpr double r =  2.0;
-constexpr int Kp = 100;
-constexpr int Kv = 1000;
-constexpr double ha = 1.0;
-constexpr double d = 0.3;
 //constexpr double D = 2.5;
 constexpr double viability = 1e-6;
-constexpr double alpha = 1.0;
 
+//Model parameters, loaded per run from a file ("key value" lines) or from "key=value" arguments
+struct Params
+{
+    double m = 0.2;
+    double r = 2.0;
+    double Kp = 100;
+    double Kv = 1000;
+    double ha = 1.0;
+    double d = 0.3;
+    double alpha = 1.0;
+};
 
 
-bool plantExistsInPatch(int plantID, int site, int insectCount, const vector<vector<vector<double>>>& gamma);
-bool insectExistsInPatch(int insectID, int site, int plantCount, const vector<vector<vector<double>>>& gamma);
+bool setParam(Params& par, const string& key, double value);
+bool parseParam(const string& token, Params& par);
+bool loadParams(const string& filename, Params& par);
+//Command line parameters: files and key=value tokens; "threads=N" sets the integrator threads
+bool readParams(int argc, char** argv, Params& par);
+void printParams(const Params& par);
 
-void evaluaFp(double p, const vector<vector<double>>& v, double &fp, const vector<vector<vector<double>>>& gamma, int pindex, int site, int insectCount);
+//Threads used by findSteadyState to evaluate each RK4 step (1 by default). Only worth it for large
+//networks, where a step is long compared with the synchronisation between its stages.
+void setIntegratorThreads(int numThreads);
+int integratorThreads();
 
-void evaluaFv(const vector<vector<double>>& p, const vector<vector<double>>& v, double &fv, const vector<vector<vector<double>>>& gamma, int vindex, int site, int plantCount, int numpatch, double D);
+//Metrics after each removal of an extinction experiment
+struct ExtinctionStep
+{
+    int numExtinctions;
+    double robustness;
+    int survPlants;
+    int survInsects;
+    double pollinationService;
+    double giniP;
+    double giniV;
+};
 
-void rungekutta(vector<vector<double>>& p, vector<vector<double>>& v, const vector<vector<vector<double>>>& gamma, double h, int plantCount, int insectCount, int numpatch, double D);
+//Per-capita mutualistic gain for a weighted sum of partner abundances
+double functionalResponse(double sumden, const Params& par);
 
-void findSteadyState(double t, vector<vector<double>>& p, vector<vector<double>>& v, ofstream& fichp, ofstream& fichv, int plantCount, int insectCount, int numpatch,  const vector<vector<vector<double>>>& gamma, double h, double D);
+//Model functions are templated on the storage type of the state and gamma (T = double or float).
+//Those that report progress write it to log, so a caller can silence or redirect one call.
+template<typename T> bool plantExistsInPatch(int plantID, int site, int insectCount, const vector<vector<vector<T>>>& gamma);
+template<typename T> bool insectExistsInPatch(int insectID, int site, int plantCount, const vector<vector<vector<T>>>& gamma);
 
-void loadGamma(const string &filename, map<string, int>& plantIndex, map<string, int>& insectIndex, int& plantCount, int& insectCount, int& numpatch, vector<vector<vector<double>>>& gamma);
+template<typename T> void evaluaFp(T p, const vector<vector<T>>& v, T &fp, const vector<vector<vector<T>>>& gamma, const Params& par, int pindex, int site, int insectCount);
 
-void runExtinctionExperiment(const vector<vector<double>>& p, const vector<vector<double>>& v, const vector<vector<vector<double>>>& gamma, double h, int plantCount, int insectCount, int numpatch, double D);
+template<typename T> void evaluaFv(const vector<vector<T>>& p, const vector<vector<T>>& v, T &fv, const vector<vector<vector<T>>>& gamma, const Params& par, int vindex, int site, int plantCount, int numpatch, double D);
 
+template<typename T> void rungekutta(vector<vector<T>>& p, vector<vector<T>>& v, const vector<vector<vector<T>>>& gamma, const Params& par, double h, int plantCount, int insectCount, int numpatch, double D);
 
-void runRandomExtinctionExperiment(const vector<vector<double>>& p, const vector<vector<double>>& v, const vector<vector<vector<double>>>& gamma, double h, int plantCount, int insectCount, int numpatch, double D);
+template<typename T> void findSteadyState(double t, vector<vector<T>>& p, vector<vector<T>>& v, ofstream& fichp, ofstream& fichv, int plantCount, int insectCount, int numpatch,  const vector<vector<vector<T>>>& gamma, const Params& par, double h, double D, ostream& log = cout);
+
+template<typename T> void loadGamma(const string &filename, map<string, int>& plantIndex, map<string, int>& insectIndex, int& plantCount, int& insectCount, int& numpatch, vector<vector<vector<T>>>& gamma, ostream& log = cout);
+
+//Species names by index, plants first and then insects
+vector<string> speciesNames(const map<string, int>& plantIndex, const map<string, int>& insectIndex, int plantCount, int insectCount);
+
+template<typename T> void initializeState(vector<vector<T>>& p, vector<vector<T>>& v, const vector<vector<vector<T>>>& gamma, int plantCount, int insectCount, int numpatch);
+
+template<typename T> void countSurvivors(const vector<vector<T>>& p, const vector<vector<T>>& v, int plantCount, int insectCount, int numpatch, int& survPlants, int& survInsects);
+
+template<typename T> ExtinctionStep measureStep(int numExtinctions, const vector<vector<T>>& p, const vector<vector<T>>& v, int plantCount, int insectCount, int numpatch, int totalInitialSpecies);
+
+//Zeroes the species that have provably lost every mutualistic partner, repeating until no more fall;
+//returns the number of species driven extinct
+template<typename T> int cascadeExtinctions(vector<vector<T>>& p, vector<vector<T>>& v, const vector<vector<vector<T>>>& gamma, const Params& par, int plantCount, int insectCount, int numpatch, double D);
+
+template<typename T> vector<ExtinctionStep> runExtinctionExperiment(const vector<vector<T>>& p, const vector<vector<T>>& v, const vector<vector<vector<T>>>& gamma, const Params& par, double h, int plantCount, int insectCount, int numpatch, double D, ostream& log = cout);
+
+
+template<typename T> vector<ExtinctionStep> runRandomExtinctionExperiment(const vector<vector<T>>& p, const vector<vector<T>>& v, const vector<vector<vector<T>>>& gamma, const Params& par, double h, int plantCount, int insectCount, int numpatch, double D, unsigned seed, ostream& log = cout);
+
+double robustnessIndex(const vector<ExtinctionStep>& curve);
+
+double writeExtinctionResults(const vector<ExtinctionStep>& curve, const string& resultsFile, const string& robustnessFile);
 
 #endif
@@ -0,0 +1,107 @@
+//Precision check: runs the extinction experiments in double and float on every bundled site
+//and reports how far the float robustness curves drift from the double reference
+//
+//  ./precision.exe <h> <D> [params.txt] [key=value ...]
+
+#include "model.h"
+
+#include <chrono>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+template<typename T>
+vector<ExtinctionStep> runSite(const string& filename, const Params& par, double h, double D, bool random, double& seconds)
+{
+    auto start = chrono::steady_clock::now();
+
+    map<string, int> plantIndex;
+    map<string, int> insectIndex;
+    int plantCount = 0, insectCount = 0, numPatch = 0;
+    vector<vector<vector<T>>> gamma;
+
+    loadGamma(filename, plantIndex, insectIndex, plantCount, insectCount, numPatch, gamma);
+
+    vector<vector<T>> p, v;
+    initializeState(p, v, gamma, plantCount, insectCount, numPatch);
+
+    ofstream dummy_p("/dev/null");
+    ofstream dummy_v("/dev/null");
+    findSteadyState(0.0, p, v, dummy_p, dummy_v, plantCount, insectCount, numPatch, gamma, par, h, D);
+
+    vector<ExtinctionStep> curve;
+    if (random)
+        curve = runRandomExtinctionExperiment(p, v, gamma, par, h, plantCount, insectCount, numPatch, D, 42);
+    else
+        curve = runExtinctionExperiment(p, v, gamma, par, h, plantCount, insectCount, numPatch, D);
+
+    seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return curve;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3)
+    {
+        cerr << "Usage: " << argv[0] << " <h> <D> [params.txt] [key=value ...]" << endl;
+        return 1;
+    }
+
+    double h = atof(argv[1]);
+    double D = atof(argv[2]);
+
+    Params par;
+    if (!readParams(argc - 2, argv + 2, par))
+        return 1;
+
+    vector<string> sites;
+    for (const auto& entry : fs::directory_iterator("."))
+    {
+        string name = entry.path().filename().string();
+        if (name.rfind("interactions_", 0) == 0 && name.size() > 12 && name.substr(name.size() - 12) == "_patches.txt")
+            sites.push_back(name);
+    }
+    sort(sites.begin(), sites.end());
+
+    ostringstream report;
+    report << "# Site Strategy Steps_Double Steps_Float Max_Robustness_Drift Steps_Differing R_Double R_Float Time_Double Time_Float" << endl;
+
+    double worst = 0.0;
+
+    for (const auto& site : sites)
+    {
+        for (bool random : {false, true})
+        {
+            //The model's own progress output is not part of the report
+            streambuf* console = cout.rdbuf();
+            ofstream quiet("/dev/null");
+            cout.rdbuf(quiet.rdbuf());
+
+            double tDouble, tFloat;
+            vector<ExtinctionStep> ref = runSite<double>(site, par, h, D, random, tDouble);
+            vector<ExtinctionStep> low = runSite<float>(site, par, h, D, random, tFloat);
+
+            cout.rdbuf(console);
+
+            double drift = 0.0;
+            int differing = 0;
+            size_t steps = min(ref.size(), low.size());
+            for (size_t k=0 ; k<steps ; k++)
+            {
+                drift = max(drift, abs(ref[k].robustness - low[k].robustness));
+                if (ref[k].survPlants != low[k].survPlants || ref[k].survInsects != low[k].survInsects)
+                    differing++;
+            }
+            differing += max(ref.size(), low.size()) - steps;
+            worst = max(worst, drift);
+
+            report << site.substr(13, site.size() - 25) << " " << (random ? "random" : "ordered") << " " << ref.size() << " " << low.size() << " "
+                   << drift << " " << differing << " " << robustnessIndex(ref) << " " << robustnessIndex(low) << " " << tDouble << " " << tFloat << endl;
+        }
+    }
+
+    cout << report.str();
+    cout << "Max robustness drift (float vs double): " << worst << endl;
+
+    return 0;
+}
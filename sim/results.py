@@ -2,23 +2,27 @@ import pandas as pd
 import matplotlib.pyplot as plt
 import seaborn as sns
 
+from metapop import Model, EXTINCTION_COLUMNS
+
 # === Configuración Estética ===
 # Usamos un estilo limpio para publicaciones académicas
 sns.set_theme(style="whitegrid")
 plt.rcParams.update({'font.size': 10, 'figure.titlesize': 16})
 
-# === 1. Cargar Datos ===
-filename = 'results.txt'
-print(f"Leyendo datos de {filename}...")
-
-try:
-    # Leemos el archivo generado por C++
-    # Asumimos columnas: K, Robustez, SurvPlants, SurvInsects, Service, GiniP, GiniI
-    df = pd.read_csv(filename, sep='\s+', comment='#', header=None,
-                     names=['K', 'Robustez', 'SurvPlants', 'SurvInsects', 'Service', 'GiniP', 'GiniI'])
-except FileNotFoundError:
-    print(f"ERROR: No se encuentra '{filename}'. Ejecuta primero la simulación en C++.")
-    exit()
+# === 1. Simular ===
+INTERACTION_FILE = 'interactions_Dolebury_Warren_patches.txt'
+STEP_H = 0.01
+D = 1.0
+
+print(f"Simulando {INTERACTION_FILE} (h={STEP_H}, D={D})...")
+
+# El motor C++ se llama directamente (libmetapop.so): sin results.txt de por medio
+model = Model(INTERACTION_FILE)
+model.steady_state(STEP_H, D)
+curve = model.extinction(STEP_H, D)
+
+# Columnas: K, Robustez, SurvPlants, SurvInsects, Service, GiniP, GiniI
+df = pd.DataFrame(curve, columns=EXTINCTION_COLUMNS)
 
 # === 2. Procesar Datos ===
 # Normalizamos el Eje X: 0.0 = Inicio, 1.0 = Todas las plantas eliminadas
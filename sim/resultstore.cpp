@@ -0,0 +1,176 @@
+//Append-only columnar result store (see resultstore.h)
+
+#include "resultstore.h"
+
+#include <filesystem>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+
+namespace fs = std::filesystem;
+
+//One column of the batch being appended, already encoded
+struct Column
+{
+    string file;
+    size_t width;
+    vector<char> data;
+};
+
+template<typename V>
+void put(Column& column, V value)
+{
+    const char* bytes = reinterpret_cast<const char*>(&value);
+    column.data.insert(column.data.end(), bytes, bytes + sizeof(V));
+}
+
+bool writeAll(int fd, const char* data, size_t size)
+{
+    while (size > 0)
+    {
+        ssize_t written = write(fd, data, size);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        data += written;
+        size -= written;
+    }
+    return true;
+}
+
+//Cuts the file to the committed size, appends and syncs
+bool appendAt(const fs::path& path, off_t committed, const char* data, size_t size)
+{
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT, 0644);
+    if (fd < 0)
+        return false;
+
+    bool ok = ftruncate(fd, committed) == 0 && lseek(fd, committed, SEEK_SET) == committed && writeAll(fd, data, size) && fsync(fd) == 0;
+    close(fd);
+    return ok;
+}
+
+uint64_t storeTag(const string& key)
+{
+    //FNV-1a; 0 is reserved for untagged batches
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : key)
+    {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash == 0 ? 1 : hash;
+}
+
+uint64_t runTag(const string& site, double h, double D, int strategy, unsigned seed, const Params& par, int precision)
+{
+    ostringstream key;
+    key << hexfloat << site << " " << h << " " << D << " " << strategy << " " << seed << " " << precision << " "
+        << par.m << " " << par.r << " " << par.Kp << " " << par.Kv << " " << par.ha << " " << par.d << " " << par.alpha;
+    return storeTag(key.str());
+}
+
+int siteCode(const fs::path& dir, const string& site)
+{
+    fs::path dictFile = dir / "sites.txt";
+
+    ifstream dict(dictFile);
+    string name;
+    int code = 0;
+    while (getline(dict, name))
+    {
+        if (name == site)
+            return code;
+        code++;
+    }
+    dict.close();
+
+    string line = site + "\n";
+    off_t size = fs::exists(dictFile) ? fs::file_size(dictFile) : 0;
+    if (!appendAt(dictFile, size, line.data(), line.size()))
+        return -1;
+
+    return code;
+}
+
+bool appendToStore(const string& storeDir, const string& site, double h, double D, int strategy, unsigned seed, const Params& par, int precision, const vector<ExtinctionStep>& curve, uint64_t tag, bool replace)
+{
+    fs::path dir = storeDir;
+    error_code ec;
+    fs::create_directories(dir, ec);
+
+    int lock = open((dir / "lock").c_str(), O_RDWR | O_CREAT, 0644);
+    if (lock < 0 || flock(lock, LOCK_EX) != 0)
+    {
+        cerr << "Cannot lock result store " << storeDir << endl;
+        if (lock >= 0)
+            close(lock);
+        return false;
+    }
+
+    //Committed batches; a trailing partial record is what a crash mid-commit leaves
+    vector<StoreBatch> index;
+    fs::path indexFile = dir / "index.bin";
+    if (fs::exists(indexFile))
+    {
+        index.resize(fs::file_size(indexFile)/sizeof(StoreBatch));
+        ifstream in(indexFile, ios::binary);
+        in.read(reinterpret_cast<char*>(index.data()), index.size()*sizeof(StoreBatch));
+    }
+
+    bool ok = true;
+    bool committed = false;
+
+    for (const auto& batch : index)
+        if (!replace && tag != 0 && batch.tag == tag)
+            committed = true;
+
+    if (!committed)
+    {
+        int64_t rows = index.empty() ? 0 : index.back().firstRow + index.back().rowCount;
+        int code = siteCode(dir, site);
+        ok = (code >= 0);
+
+        vector<Column> columns = {
+            {"site.i32", 4, {}}, {"D.f64", 8, {}}, {"strategy.i32", 4, {}}, {"seed.u32", 4, {}}, {"precision.i32", 4, {}}, {"step.i32", 4, {}},
+            {"numExtinctions.i32", 4, {}}, {"robustness.f64", 8, {}}, {"survPlants.i32", 4, {}}, {"survInsects.i32", 4, {}},
+            {"pollinationService.f64", 8, {}}, {"giniP.f64", 8, {}}, {"giniV.f64", 8, {}}
+        };
+
+        for (size_t k=0 ; k<curve.size() ; k++)
+        {
+            const ExtinctionStep& step = curve[k];
+            put<int32_t>(columns[0], code);
+            put<double>(columns[1], D);
+            put<int32_t>(columns[2], strategy);
+            put<uint32_t>(columns[3], seed);
+            put<int32_t>(columns[4], precision);
+            put<int32_t>(columns[5], k);
+            put<int32_t>(columns[6], step.numExtinctions);
+            put<double>(columns[7], step.robustness);
+            put<int32_t>(columns[8], step.survPlants);
+            put<int32_t>(columns[9], step.survInsects);
+            put<double>(columns[10], step.pollinationService);
+            put<double>(columns[11], step.giniP);
+            put<double>(columns[12], step.giniV);
+        }
+
+        for (const auto& column : columns)
+            ok = ok && appendAt(dir / column.file, rows*column.width, column.data.data(), column.data.size());
+
+        //Commit
+        StoreBatch batch = {code, strategy, seed, (uint32_t)precision, D, h, par, rows, (int64_t)curve.size(), tag};
+        ok = ok && appendAt(indexFile, index.size()*sizeof(StoreBatch), reinterpret_cast<const char*>(&batch), sizeof(batch));
+    }
+
+    flock(lock, LOCK_UN);
+    close(lock);
+
+    if (!ok)
+        cerr << "Could not append to result store " << storeDir << endl;
+
+    return ok;
+}
@@ -0,0 +1,55 @@
+#ifndef RESULTSTORE_H
+#define RESULTSTORE_H
+
+#include "model.h"
+
+#include <cstdint>
+
+//Append-only columnar store for extinction experiment curves (read from Python with resultstore.py).
+//
+//A store is a directory with one raw little-endian file per column, named <column>.<type>:
+//  key:     site.i32 D.f64 strategy.i32 seed.u32 precision.i32 step.i32
+//  metrics: numExtinctions.i32 robustness.f64 survPlants.i32 survInsects.i32 pollinationService.f64 giniP.f64 giniV.f64
+//sites.txt maps site codes (line number) to names, and index.bin holds one StoreBatch per appended curve
+//with its key and the rest of its inputs (h and the model parameters), so that runs differing only in
+//those can be told apart.
+//
+//Writers serialise on an flock of <store>/lock. A batch is committed by its index record, written
+//after the columns are synced, so readers never see rows of a batch that did not finish; column
+//bytes past the last committed row are left by a crashed writer and cut by the next one.
+
+//Removal sequence of a curve: plants (extinction experiments) or patches (habitat loss)
+enum Strategy { STRATEGY_ORDERED = 0, STRATEGY_RANDOM = 1, STRATEGY_HABITAT_ORDERED = 2, STRATEGY_HABITAT_RANDOM = 3 };
+
+//Precision of the state a curve was computed with, in bytes per value
+enum Precision { PRECISION_FLOAT = 4, PRECISION_DOUBLE = 8 };
+
+struct StoreBatch
+{
+    int32_t site;
+    int32_t strategy;
+    uint32_t seed;
+    uint32_t precision;
+    double D;
+    double h;
+    Params par;
+    int64_t firstRow;
+    int64_t rowCount;
+    uint64_t tag;
+};
+
+static_assert(sizeof(StoreBatch) == 112, "index.bin records are read from Python with a fixed layout");
+
+//Tag of a batch (0 for none). Readers only see the last committed batch of each non-zero tag
+uint64_t storeTag(const string& key);
+
+//Tag built from every input of a run, for callers without a job id of their own
+uint64_t runTag(const string& site, double h, double D, int strategy, unsigned seed, const Params& par, int precision);
+
+//With replace, the curve is always appended and supersedes earlier batches with the same tag, so
+//re-running an experiment after the engine changed leaves its new curve visible and no duplicate.
+//Without it, a tag already in the index is not appended again: that is the retry of a job that
+//crashed after storing its curve. Returns false if the store could not be written
+bool appendToStore(const string& storeDir, const string& site, double h, double D, int strategy, unsigned seed, const Params& par, int precision, const vector<ExtinctionStep>& curve, uint64_t tag, bool replace);
+
+#endif
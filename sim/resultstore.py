@@ -0,0 +1,114 @@
+"""
+Lectura del almacén columnar de resultados (ver resultstore.h).
+
+Cada columna es un fichero binario que se abre con np.memmap, de modo que
+solo se lee del disco lo que se filtra. El índice (index.bin) tiene una
+entrada por curva de extinción, así que los filtros por sitio, D,
+estrategia o semilla se resuelven sin tocar las columnas. Si una curva
+se vuelve a calcular con la misma etiqueta, solo se ve la más reciente.
+
+Uso:
+    from resultstore import ResultStore
+    store = ResultStore('results.store')
+    rows = store.query(site='Dolebury_Warren', strategy='ordered', precision='double')
+    rows['robustness'], rows['D'], ...
+"""
+
+import os
+
+import numpy as np
+
+STRATEGIES = {'ordered': 0, 'random': 1, 'habitat_ordered': 2, 'habitat_random': 3}
+
+PRECISIONS = {'float': 4, 'double': 8}
+
+PARAMS = ['m', 'r', 'Kp', 'Kv', 'ha', 'd', 'alpha']
+
+BATCH_DTYPE = np.dtype([('site', '<i4'), ('strategy', '<i4'), ('seed', '<u4'), ('precision', '<u4'),
+                        ('D', '<f8'), ('h', '<f8')] + [(name, '<f8') for name in PARAMS] +
+                       [('firstRow', '<i8'), ('rowCount', '<i8'), ('tag', '<u8')])
+
+_TYPES = {'i32': '<i4', 'u32': '<u4', 'f64': '<f8'}
+
+
+class ResultStore:
+    def __init__(self, path):
+        self.path = path
+        self.refresh()
+
+    def refresh(self):
+        """Vuelve a leer el índice: las curvas añadidas desde entonces pasan a ser visibles."""
+        index_file = os.path.join(self.path, 'index.bin')
+        if os.path.exists(index_file):
+            # Un registro incompleto al final es un commit que no llegó a terminar
+            count = os.path.getsize(index_file) // BATCH_DTYPE.itemsize
+            self.index = np.fromfile(index_file, dtype=BATCH_DTYPE, count=count)
+        else:
+            self.index = np.zeros(0, dtype=BATCH_DTYPE)
+
+        self.rows = int(self.index['firstRow'][-1] + self.index['rowCount'][-1]) if len(self.index) else 0
+
+        # Una curva vuelta a calcular con la misma etiqueta reemplaza a las anteriores: solo se ve la última
+        tags = self.index['tag']
+        _, last = np.unique(tags[::-1], return_index=True)
+        keep = tags == 0
+        keep[len(tags) - 1 - last] = True
+        self.index = self.index[keep]
+
+        sites_file = os.path.join(self.path, 'sites.txt')
+        self.sites = open(sites_file).read().split() if os.path.exists(sites_file) else []
+
+        self._columns = {}
+        if self.rows > 0:
+            for name in os.listdir(self.path):
+                column, _, kind = name.rpartition('.')
+                if kind in _TYPES:
+                    self._columns[column] = np.memmap(os.path.join(self.path, name), dtype=_TYPES[kind],
+                                                      mode='r', shape=(self.rows,))
+
+    @property
+    def columns(self):
+        return sorted(self._columns)
+
+    def batches(self, site=None, D=None, strategy=None, seed=None, precision=None, h=None, params=None):
+        """Entradas del índice (una por curva) que cumplen el filtro.
+
+        precision es 'double' o 'float'; params es un diccionario con los parámetros del modelo
+        que deben coincidir (p. ej. {'r': 2.0, 'Kp': 100})."""
+        mask = np.ones(len(self.index), dtype=bool)
+        if site is not None:
+            if site not in self.sites:
+                return self.index[:0]
+            mask &= self.index['site'] == self.sites.index(site)
+        if D is not None:
+            mask &= np.isclose(self.index['D'], D)
+        if strategy is not None:
+            mask &= self.index['strategy'] == STRATEGIES.get(strategy, strategy)
+        if seed is not None:
+            mask &= self.index['seed'] == seed
+        if precision is not None:
+            mask &= self.index['precision'] == PRECISIONS.get(precision, precision)
+        if h is not None:
+            mask &= np.isclose(self.index['h'], h)
+        for name, value in (params or {}).items():
+            mask &= np.isclose(self.index[name], value)
+        return self.index[mask]
+
+    def query(self, site=None, D=None, strategy=None, seed=None, precision=None, h=None, params=None, columns=None):
+        """Filas de las curvas que cumplen el filtro, como diccionario columna -> array."""
+        selected = self.batches(site, D, strategy, seed, precision, h, params)
+        columns = columns or self.columns
+
+        if len(selected) == 0:
+            return {name: np.zeros(0, dtype=self._columns[name].dtype) if name in self._columns else np.zeros(0)
+                    for name in columns}
+
+        rows = np.concatenate([np.arange(b['firstRow'], b['firstRow'] + b['rowCount']) for b in selected])
+        return {name: np.asarray(self._columns[name][rows]) for name in columns}
+
+    def robustness(self, site=None, D=None, strategy=None, seed=None, precision=None, h=None, params=None):
+        """R de cada curva (media de la robustez a lo largo de la curva), junto a su entrada del índice."""
+        selected = self.batches(site, D, strategy, seed, precision, h, params)
+        robustness = self._columns.get('robustness')
+        values = np.array([robustness[b['firstRow']:b['firstRow'] + b['rowCount']].mean() for b in selected])
+        return selected, values
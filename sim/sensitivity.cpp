@@ -0,0 +1,258 @@
+//Parametric sensitivities of the steady state (implicit function theorem on the equilibrium Jacobian)
+
+#include "sensitivity.h"
+
+//Functional response g(S) = alpha S / (1 + ha alpha S) and its derivatives
+struct Response
+{
+    double g, dS, dha, dalpha;
+};
+
+Response responseDerivatives(double sumden, const Params& par)
+{
+    double u = par.alpha*sumden;
+    double den = 1.0 + par.ha*u;
+
+    Response res;
+    res.g = functionalResponse(sumden, par);
+    res.dS = par.alpha/(den*den);
+    res.dha = -u*u/(den*den);
+    res.dalpha = sumden/(den*den);
+    return res;
+}
+
+void stateJacobian(const vector<vector<double>>& p, const vector<vector<double>>& v, const vector<vector<vector<double>>>& gamma, const Params& par, int plantCount, int insectCount, int numPatch, double D, vector<double>& J)
+{
+    int n = (plantCount + insectCount)*numPatch;
+    J.assign((size_t)n*n, 0.0);
+
+    auto plant = [numPatch](int i, int site) { return i*numPatch + site; };
+    auto insect = [numPatch, plantCount](int j, int site) { return (plantCount + j)*numPatch + site; };
+
+    for(int i=0 ; i<plantCount ; i++)
+    {
+        for(int site=0 ; site<numPatch ; site++)
+        {
+            double sumden = 0.0;
+            for(int j=0 ; j<insectCount ; j++)
+                sumden += gamma[site][i][j] * v[j][site];
+
+            Response res = responseDerivatives(sumden, par);
+            size_t row = (size_t)plant(i, site)*n;
+
+            J[row + plant(i, site)] = -par.m - (2.0*par.r*p[i][site])/par.Kp + res.g;
+            for(int j=0 ; j<insectCount ; j++)
+                if (gamma[site][i][j] != 0.0)
+                    J[row + insect(j, site)] = p[i][site]*res.dS*gamma[site][i][j];
+        }
+    }
+
+    for(int j=0 ; j<insectCount ; j++)
+    {
+        for(int site=0 ; site<numPatch ; site++)
+        {
+            double sumden = 0.0;
+            for(int i=0 ; i<plantCount ; i++)
+                sumden += gamma[site][i][j] * p[i][site];
+
+            Response res = responseDerivatives(sumden, par);
+            size_t row = (size_t)insect(j, site)*n;
+            double vs = v[j][site];
+
+            J[row + insect(j, site)] = -par.d*(1.0 + vs/par.Kv) - par.d*vs/par.Kv + res.g - D*(numPatch-1);
+            for(int q=0 ; q<numPatch ; q++)
+                if (q != site)
+                    J[row + insect(j, q)] = D;
+            for(int i=0 ; i<plantCount ; i++)
+                if (gamma[site][i][j] != 0.0)
+                    J[row + plant(i, site)] = vs*res.dS*gamma[site][i][j];
+        }
+    }
+
+    return;
+}
+
+void parameterJacobian(const vector<vector<double>>& p, const vector<vector<double>>& v, const vector<vector<vector<double>>>& gamma, const Params& par, int plantCount, int insectCount, int numPatch, vector<vector<double>>& dF)
+{
+    int n = (plantCount + insectCount)*numPatch;
+    dF.assign(SENSITIVITY_PARAMS.size(), vector<double>(n, 0.0));
+
+    //Rows follow SENSITIVITY_PARAMS: D m r Kp Kv ha d alpha
+    for(int i=0 ; i<plantCount ; i++)
+    {
+        for(int site=0 ; site<numPatch ; site++)
+        {
+            double sumden = 0.0;
+            for(int j=0 ; j<insectCount ; j++)
+                sumden += gamma[site][i][j] * v[j][site];
+
+            Response res = responseDerivatives(sumden, par);
+            int k = i*numPatch + site;
+            double ps = p[i][site];
+
+            dF[1][k] = -ps;
+            dF[2][k] = -ps*ps/par.Kp;
+            dF[3][k] = par.r*ps*ps/(par.Kp*par.Kp);
+            dF[5][k] = ps*res.dha;
+            dF[7][k] = ps*res.dalpha;
+        }
+    }
+
+    for(int j=0 ; j<insectCount ; j++)
+    {
+        for(int site=0 ; site<numPatch ; site++)
+        {
+            double sumden = 0.0;
+            for(int i=0 ; i<plantCount ; i++)
+                sumden += gamma[site][i][j] * p[i][site];
+
+            Response res = responseDerivatives(sumden, par);
+            int k = (plantCount + j)*numPatch + site;
+            double vs = v[j][site];
+
+            double sumD = 0.0;
+            for(int q=0 ; q<numPatch ; q++)
+                if (q != site)
+                    sumD += (v[j][q] - vs);
+
+            dF[0][k] = sumD;
+            dF[4][k] = par.d*vs*vs/(par.Kv*par.Kv);
+            dF[5][k] = vs*res.dha;
+            dF[6][k] = -vs*(1.0 + vs/par.Kv);
+            dF[7][k] = vs*res.dalpha;
+        }
+    }
+
+    return;
+}
+
+//Solves A X = B in place (B holds one right-hand side per row) by LU with partial pivoting
+bool solveLinear(vector<double>& A, int n, vector<vector<double>>& B)
+{
+    double scale = 0.0;
+    for (double a : A)
+        scale = max(scale, abs(a));
+
+    for(int col=0 ; col<n ; col++)
+    {
+        int pivot = col;
+        for(int row=col+1 ; row<n ; row++)
+            if (abs(A[(size_t)row*n + col]) > abs(A[(size_t)pivot*n + col]))
+                pivot = row;
+
+        if (abs(A[(size_t)pivot*n + col]) <= 1e-13*scale)
+            return false;
+
+        if (pivot != col)
+        {
+            for(int k=0 ; k<n ; k++)
+                swap(A[(size_t)pivot*n + k], A[(size_t)col*n + k]);
+            for (auto& b : B)
+                swap(b[pivot], b[col]);
+        }
+
+        double diag = A[(size_t)col*n + col];
+        for(int row=col+1 ; row<n ; row++)
+        {
+            double factor = A[(size_t)row*n + col]/diag;
+            if (factor == 0.0)
+                continue;
+
+            for(int k=col ; k<n ; k++)
+                A[(size_t)row*n + k] -= factor*A[(size_t)col*n + k];
+            for (auto& b : B)
+                b[row] -= factor*b[col];
+        }
+    }
+
+    for (auto& b : B)
+    {
+        for(int row=n-1 ; row>=0 ; row--)
+        {
+            double sum = b[row];
+            for(int k=row+1 ; k<n ; k++)
+                sum -= A[(size_t)row*n + k]*b[k];
+            b[row] = sum/A[(size_t)row*n + row];
+        }
+    }
+
+    return true;
+}
+
+bool steadyStateSensitivities(const vector<vector<double>>& p, const vector<vector<double>>& v, const vector<vector<vector<double>>>& gamma, const Params& par, int plantCount, int insectCount, int numPatch, double D, vector<vector<double>>& sens)
+{
+    int n = (plantCount + insectCount)*numPatch;
+
+    vector<double> J;
+    stateJacobian(p, v, gamma, par, plantCount, insectCount, numPatch, D, J);
+    parameterJacobian(p, v, gamma, par, plantCount, insectCount, numPatch, sens);
+
+    for (auto& row : sens)
+        for (double& x : row)
+            x = -x;
+
+    return solveLinear(J, n, sens);
+}
+
+void writeSensitivities(const vector<vector<double>>& p, const vector<vector<double>>& v, const vector<vector<double>>& sens, const vector<string>& names, const Params& par, int plantCount, int insectCount, int numPatch, double D, const string& filename)
+{
+    int numParams = SENSITIVITY_PARAMS.size();
+    vector<double> value = {D, par.m, par.r, par.Kp, par.Kv, par.ha, par.d, par.alpha};
+
+    //Totals per species and their derivatives
+    int speciesCount = plantCount + insectCount;
+    vector<double> total(speciesCount, 0.0);
+    vector<vector<double>> dTotal(speciesCount, vector<double>(numParams, 0.0));
+
+    for(int s=0 ; s<speciesCount ; s++)
+    {
+        for(int site=0 ; site<numPatch ; site++)
+        {
+            total[s] += (s < plantCount) ? p[s][site] : v[s-plantCount][site];
+            for(int k=0 ; k<numParams ; k++)
+                dTotal[s][k] += sens[k][s*numPatch + site];
+        }
+    }
+
+    ofstream sensFile(filename);
+
+    //Community metrics, as in results.txt: biomass of surviving plants and pollination service (insect biomass)
+    sensFile << "# Parameter Value dPlantBiomass dPollinationService Elasticity_PlantBiomass Elasticity_PollinationService" << endl;
+
+    double plantBiomass = 0.0, insectBiomass = 0.0;
+    for(int s=0 ; s<speciesCount ; s++)
+        if (total[s] > viability)
+            (s < plantCount ? plantBiomass : insectBiomass) += total[s];
+
+    for(int k=0 ; k<numParams ; k++)
+    {
+        double dPlant = 0.0, dInsect = 0.0;
+        for(int s=0 ; s<speciesCount ; s++)
+            if (total[s] > viability)
+                (s < plantCount ? dPlant : dInsect) += dTotal[s][k];
+
+        sensFile << SENSITIVITY_PARAMS[k] << " " << value[k] << " " << dPlant << " " << dInsect << " "
+                 << (plantBiomass > 0 ? value[k]*dPlant/plantBiomass : 0.0) << " " << (insectBiomass > 0 ? value[k]*dInsect/insectBiomass : 0.0) << endl;
+    }
+
+    //Surviving species: total abundance and its derivative with respect to each parameter
+    sensFile << endl << "# Species Type Abundance";
+    for (const auto& name : SENSITIVITY_PARAMS)
+        sensFile << " d_" << name;
+    sensFile << endl;
+
+    for(int s=0 ; s<speciesCount ; s++)
+    {
+        if (total[s] <= viability)
+            continue;
+
+        sensFile << names[s] << " " << (s < plantCount ? "plant" : "insect") << " " << total[s];
+        for(int k=0 ; k<numParams ; k++)
+            sensFile << " " << dTotal[s][k];
+        sensFile << endl;
+    }
+
+    sensFile.close();
+
+    return;
+}
@@ -0,0 +1,23 @@
+#ifndef SENSITIVITY_H
+#define SENSITIVITY_H
+
+#include "model.h"
+
+//Parameters the steady state is differentiated against, in the order of the sensitivity rows
+const vector<string> SENSITIVITY_PARAMS = {"D", "m", "r", "Kp", "Kv", "ha", "d", "alpha"};
+
+//Jacobian of (fp, fv) with respect to the state, n x n row-major with n = (plantCount + insectCount)*numpatch.
+//State index: plant i in patch s is i*numpatch + s, insect j in patch s is (plantCount + j)*numpatch + s.
+void stateJacobian(const vector<vector<double>>& p, const vector<vector<double>>& v, const vector<vector<vector<double>>>& gamma, const Params& par, int plantCount, int insectCount, int numpatch, double D, vector<double>& J);
+
+//Derivatives of (fp, fv) with respect to each of SENSITIVITY_PARAMS, one row of n per parameter
+void parameterJacobian(const vector<vector<double>>& p, const vector<vector<double>>& v, const vector<vector<vector<double>>>& gamma, const Params& par, int plantCount, int insectCount, int numpatch, vector<vector<double>>& dF);
+
+//d(state)/d(parameter) at a steady state from the implicit function theorem, J dx/dθ = -dF/dθ.
+//Returns false if the Jacobian is singular (the equilibrium is not isolated).
+bool steadyStateSensitivities(const vector<vector<double>>& p, const vector<vector<double>>& v, const vector<vector<vector<double>>>& gamma, const Params& par, int plantCount, int insectCount, int numpatch, double D, vector<vector<double>>& sens);
+
+//Sensitivities of plant biomass, pollination service and every surviving species' total abundance
+void writeSensitivities(const vector<vector<double>>& p, const vector<vector<double>>& v, const vector<vector<double>>& sens, const vector<string>& names, const Params& par, int plantCount, int insectCount, int numpatch, double D, const string& filename);
+
+#endif
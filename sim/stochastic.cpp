@@ -0,0 +1,363 @@
+//Stochastic demographic version of the metapopulation model (adaptive tau-leaping)
+
+#include "stochastic.h"
+
+#include <atomic>
+#include <thread>
+
+//Below this many expected events per leap, exact SSA steps are cheaper and safer than leaping
+constexpr double SSA_THRESHOLD = 10.0;
+
+//Propensities in a flat layout: 2 events per plant slot (birth, death), then 3 per insect slot
+//(birth, death, dispersal out of the patch). Slot = species*numPatch + site.
+void computePropensities(const vector<long long>& P, const vector<long long>& V, const vector<vector<vector<double>>>& gamma, const Params& par, int plantCount, int insectCount, int numPatch, double D, vector<double>& a)
+{
+    int plantSlots = plantCount*numPatch;
+
+    for(int i=0 ; i<plantCount ; i++)
+    {
+        for(int site=0 ; site<numPatch ; site++)
+        {
+            int slot = i*numPatch + site;
+            double n = P[slot];
+
+            if (n == 0)
+            {
+                a[2*slot] = a[2*slot+1] = 0.0;
+                continue;
+            }
+
+            double sumden = 0.0;
+            for(int j=0 ; j<insectCount ; j++)
+                sumden += gamma[site][i][j] * V[j*numPatch + site];
+
+            a[2*slot] = n*functionalResponse(sumden, par);
+            a[2*slot+1] = n*(par.m + (par.r*n)/par.Kp);
+        }
+    }
+
+    for(int j=0 ; j<insectCount ; j++)
+    {
+        for(int site=0 ; site<numPatch ; site++)
+        {
+            int slot = j*numPatch + site;
+            int base = 2*plantSlots + 3*slot;
+            double n = V[slot];
+
+            if (n == 0)
+            {
+                a[base] = a[base+1] = a[base+2] = 0.0;
+                continue;
+            }
+
+            double sumden = 0.0;
+            for(int i=0 ; i<plantCount ; i++)
+                sumden += gamma[site][i][j] * P[i*numPatch + site];
+
+            a[base] = n*functionalResponse(sumden, par);
+            a[base+1] = n*par.d*(1.0 + n/par.Kv);
+            a[base+2] = n*D*(numPatch-1);
+        }
+    }
+
+    return;
+}
+
+//Largest leap that keeps the expected change and variance of every population within TAU_EPSILON
+double selectTau(const vector<long long>& P, const vector<long long>& V, const vector<double>& a, int plantCount, int insectCount, int numPatch)
+{
+    int plantSlots = plantCount*numPatch;
+    double tau = INFINITY;
+
+    auto bound = [&tau](double n, double mu, double sigma2)
+    {
+        //Death rates are quadratic in n, hence the factor 2
+        double allowed = max(TAU_EPSILON*n/2.0, 1.0);
+        if (mu != 0.0)
+            tau = min(tau, allowed/abs(mu));
+        if (sigma2 > 0.0)
+            tau = min(tau, allowed*allowed/sigma2);
+    };
+
+    for(int slot=0 ; slot<plantSlots ; slot++)
+        if (P[slot] > 0)
+            bound(P[slot], a[2*slot] - a[2*slot+1], a[2*slot] + a[2*slot+1]);
+
+    for(int j=0 ; j<insectCount ; j++)
+    {
+        for(int site=0 ; site<numPatch ; site++)
+        {
+            int slot = j*numPatch + site;
+            int base = 2*plantSlots + 3*slot;
+
+            double in = 0.0;
+            for(int q=0 ; q<numPatch ; q++)
+                if (q != site && numPatch > 1)
+                    in += a[2*plantSlots + 3*(j*numPatch + q) + 2]/(numPatch-1);
+
+            if (V[slot] > 0 || in > 0.0)
+                bound(V[slot], a[base] - a[base+1] - a[base+2] + in, a[base] + a[base+1] + a[base+2] + in);
+        }
+    }
+
+    return tau;
+}
+
+//Moves n insects of species j out of site, spread uniformly over the other patches
+void disperse(vector<long long>& V, int j, int site, long long n, int numPatch, mt19937_64& rng)
+{
+    V[j*numPatch + site] -= n;
+
+    int targets = numPatch - 1;
+    for(int q=0 ; q<numPatch && n>0 ; q++)
+    {
+        if (q == site)
+            continue;
+
+        long long k = n;
+        if (targets > 1)
+        {
+            binomial_distribution<long long> split(n, 1.0/targets);
+            k = split(rng);
+        }
+
+        V[j*numPatch + q] += k;
+        n -= k;
+        targets--;
+    }
+
+    return;
+}
+
+vector<double> runStochasticReplicate(const vector<vector<double>>& p0, const vector<vector<double>>& v0, const vector<vector<vector<double>>>& gamma, const Params& par, int plantCount, int insectCount, int numPatch, double D, double tMax, mt19937_64& rng)
+{
+    int plantSlots = plantCount*numPatch;
+    int insectSlots = insectCount*numPatch;
+
+    vector<long long> P(plantSlots), V(insectSlots);
+    for(int i=0 ; i<plantCount ; i++)
+        for(int site=0 ; site<numPatch ; site++)
+            P[i*numPatch + site] = llround(p0[i][site]);
+    for(int j=0 ; j<insectCount ; j++)
+        for(int site=0 ; site<numPatch ; site++)
+            V[j*numPatch + site] = llround(v0[j][site]);
+
+    vector<double> extinction(plantCount + insectCount, -1.0);
+    vector<double> a(2*plantSlots + 3*insectSlots);
+    vector<long long> newP, newV;
+    uniform_real_distribution<double> uniform(0.0, 1.0);
+
+    double t = 0.0;
+
+    //Marks the species that have just gone extinct; returns how many are still alive
+    auto record = [&]()
+    {
+        int alive = 0;
+        for(int s=0 ; s<plantCount+insectCount ; s++)
+        {
+            if (extinction[s] >= 0.0)
+                continue;
+
+            long long total = 0;
+            for(int site=0 ; site<numPatch ; site++)
+                total += (s < plantCount) ? P[s*numPatch + site] : V[(s-plantCount)*numPatch + site];
+
+            if (total == 0)
+                extinction[s] = t;
+            else
+                alive++;
+        }
+        return alive;
+    };
+
+    if (record() == 0)
+        return extinction;
+
+    while (t < tMax)
+    {
+        computePropensities(P, V, gamma, par, plantCount, insectCount, numPatch, D, a);
+
+        double a0 = 0.0;
+        for (double rate : a)
+            a0 += rate;
+        if (a0 <= 0.0)
+            break;
+
+        double tau = selectTau(P, V, a, plantCount, insectCount, numPatch);
+
+        if (tau < SSA_THRESHOLD/a0)
+        {
+            //Exact step
+            exponential_distribution<double> wait(a0);
+            double dt = wait(rng);
+            if (t + dt > tMax)
+            {
+                t = tMax;
+                break;
+            }
+
+            double target = uniform(rng)*a0, cumulative = 0.0;
+            int event = 0;
+            while (event < (int)a.size()-1 && (cumulative += a[event]) < target)
+                event++;
+
+            if (event < 2*plantSlots)
+                P[event/2] += (event%2 == 0) ? 1 : -1;
+            else
+            {
+                int slot = (event - 2*plantSlots)/3;
+                int kind = (event - 2*plantSlots)%3;
+                if (kind == 0)
+                    V[slot]++;
+                else if (kind == 1)
+                    V[slot]--;
+                else
+                    disperse(V, slot/numPatch, slot%numPatch, 1, numPatch, rng);
+            }
+
+            t += dt;
+        }
+        else
+        {
+            tau = min(tau, tMax - t);
+
+            //Leap, halving tau whenever a population would go negative
+            while (true)
+            {
+                newP = P;
+                newV = V;
+
+                for(int slot=0 ; slot<plantSlots ; slot++)
+                {
+                    if (a[2*slot] > 0.0)
+                        newP[slot] += poisson_distribution<long long>(a[2*slot]*tau)(rng);
+                    if (a[2*slot+1] > 0.0)
+                        newP[slot] -= poisson_distribution<long long>(a[2*slot+1]*tau)(rng);
+                }
+
+                for(int slot=0 ; slot<insectSlots ; slot++)
+                {
+                    int base = 2*plantSlots + 3*slot;
+                    if (a[base] > 0.0)
+                        newV[slot] += poisson_distribution<long long>(a[base]*tau)(rng);
+                    if (a[base+1] > 0.0)
+                        newV[slot] -= poisson_distribution<long long>(a[base+1]*tau)(rng);
+                }
+
+                //Emigrants leave before they are counted anywhere else
+                for(int slot=0 ; slot<insectSlots ; slot++)
+                {
+                    int base = 2*plantSlots + 3*slot;
+                    if (a[base+2] > 0.0)
+                    {
+                        long long out = poisson_distribution<long long>(a[base+2]*tau)(rng);
+                        if (out > 0)
+                            disperse(newV, slot/numPatch, slot%numPatch, out, numPatch, rng);
+                    }
+                }
+
+                bool negative = false;
+                for (long long n : newP)
+                    negative = negative || (n < 0);
+                for (long long n : newV)
+                    negative = negative || (n < 0);
+
+                if (!negative)
+                    break;
+                tau /= 2.0;
+            }
+
+            P.swap(newP);
+            V.swap(newV);
+            t += tau;
+        }
+
+        if (record() == 0)
+            break;
+    }
+
+    return extinction;
+}
+
+vector<vector<double>> runStochasticReplicates(const vector<vector<double>>& p0, const vector<vector<double>>& v0, const vector<vector<vector<double>>>& gamma, const Params& par, int plantCount, int insectCount, int numPatch, double D, double tMax, int replicates, unsigned seed, int numThreads)
+{
+    vector<vector<double>> times(replicates);
+    atomic<int> next(0);
+
+    auto work = [&]()
+    {
+        int k;
+        while ((k = next++) < replicates)
+        {
+            seed_seq stream{seed, (unsigned)k};
+            mt19937_64 rng(stream);
+            times[k] = runStochasticReplicate(p0, v0, gamma, par, plantCount, insectCount, numPatch, D, tMax, rng);
+        }
+    };
+
+    vector<thread> pool;
+    for(int w=1 ; w<numThreads ; w++)
+        pool.emplace_back(work);
+    work();
+    for (auto& worker : pool)
+        worker.join();
+
+    return times;
+}
+
+void writeExtinctionTimes(const vector<vector<double>>& times, const vector<string>& names, int plantCount, double tMax, unsigned seed, const string& summaryFile, const string& rawFile)
+{
+    int replicates = times.size();
+    int speciesCount = names.size();
+
+    ofstream summary(summaryFile);
+    summary << "# Species Type Extinct_Fraction Mean_Time Median_Time Q05_Time Q95_Time (times of extinct replicates, tMax = " << tMax << ", seed = " << seed << ")" << endl;
+
+    for(int s=0 ; s<speciesCount ; s++)
+    {
+        vector<double> extinct;
+        for (const auto& replicate : times)
+            if (replicate[s] >= 0.0)
+                extinct.push_back(replicate[s]);
+        sort(extinct.begin(), extinct.end());
+
+        summary << names[s] << " " << (s < plantCount ? "plant" : "insect") << " " << (double)extinct.size()/replicates;
+
+        if (extinct.empty())
+        {
+            summary << " NA NA NA NA" << endl;
+            continue;
+        }
+
+        double mean = 0.0;
+        for (double time : extinct)
+            mean += time;
+        mean /= extinct.size();
+
+        auto quantile = [&extinct](double q) { return extinct[(size_t)(q*(extinct.size()-1) + 0.5)]; };
+
+        summary << " " << mean << " " << quantile(0.5) << " " << quantile(0.05) << " " << quantile(0.95) << endl;
+    }
+
+    summary.close();
+
+    //One row per replicate, one column per species; -1 = survived to tMax
+    ofstream raw(rawFile);
+    raw << "# tMax = " << tMax << ", seed = " << seed << endl;
+    raw << "# Replicate";
+    for (const auto& name : names)
+        raw << " " << name;
+    raw << endl;
+
+    for(int k=0 ; k<replicates ; k++)
+    {
+        raw << k;
+        for (double time : times[k])
+            raw << " " << time;
+        raw << endl;
+    }
+
+    raw.close();
+
+    return;
+}
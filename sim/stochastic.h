@@ -0,0 +1,24 @@
+#ifndef STOCHASTIC_H
+#define STOCHASTIC_H
+
+#include "model.h"
+
+//Demographic (individual-based) counterpart of the p/v model, simulated with adaptive tau-leaping.
+//Events per species and patch: birth through mutualism, death (m + r p/Kp for plants, d(1 + v/Kv)
+//for insects) and, for insects, dispersal to each other patch at rate D.
+
+//Relative change of the propensities allowed in one leap (Cao, Gillespie & Petzold 2006)
+constexpr double TAU_EPSILON = 0.03;
+
+//Extinction time of every species in one replicate (plants first, then insects); -1 if it survived to tMax
+vector<double> runStochasticReplicate(const vector<vector<double>>& p0, const vector<vector<double>>& v0, const vector<vector<vector<double>>>& gamma, const Params& par, int plantCount, int insectCount, int numpatch, double D, double tMax, mt19937_64& rng);
+
+//Runs the replicates on numThreads threads. Replicate k always uses the stream seeded with (seed, k),
+//so the result does not depend on the number of threads.
+vector<vector<double>> runStochasticReplicates(const vector<vector<double>>& p0, const vector<vector<double>>& v0, const vector<vector<vector<double>>>& gamma, const Params& par, int plantCount, int insectCount, int numpatch, double D, double tMax, int replicates, unsigned seed, int numThreads);
+
+//Per-species summary (extinct fraction, mean, median and 5%/95% quantiles of the extinction time) and the raw times;
+//both headers record tMax and the master seed
+void writeExtinctionTimes(const vector<vector<double>>& times, const vector<string>& names, int plantCount, double tMax, unsigned seed, const string& summaryFile, const string& rawFile);
+
+#endif